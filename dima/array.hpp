@@ -3,13 +3,13 @@
 
 #include <cassert>
 #include <cstddef>
-#include <vector>
+#include <utility>
 
 namespace dima {
     template <typename T> class Array {
       private:
-        using slot_iterator = typename std::vector<Slot<T>>::iterator;
-        using const_slot_iterator = typename std::vector<Slot<T>>::const_iterator;
+        using slot_iterator = Slot<T> *;
+        using const_slot_iterator = const Slot<T> *;
         slot_iterator first_slot;
         size_t length;
 
@@ -23,7 +23,15 @@ namespace dima {
         void retain_all() {
             const slot_iterator end = first_slot + length;
             for (auto it = first_slot; it != end; ++it) {
-                (*it).retain();
+                try {
+                    (*it).retain();
+                } catch (...) {
+                    // An element ran out of references, the ones retained already are given back
+                    for (auto retained = first_slot; retained != it; ++retained) {
+                        (*retained).release();
+                    }
+                    throw;
+                }
             }
         }
 
@@ -210,18 +218,18 @@ namespace dima {
         Array(Array &&other) noexcept :
             first_slot(other.first_slot),
             length(other.length) {
-            other.first_slot = slot_iterator(); // Invalidate the source
+            other.first_slot = nullptr; // Invalidate the source
             other.length = 0;
         }
 
         // Copy assignment
         Array &operator=(const Array &other) {
             if (this != &other) {
-                release_all();
-                first_slot = other.first_slot;
-                length = other.length;
+                // The copy retains all elements first, so this array stays untouched if that throws
+                Array copy(other);
+                std::swap(first_slot, copy.first_slot);
+                std::swap(length, copy.length);
             }
-            retain_all();
             return *this;
         }
 
@@ -231,7 +239,7 @@ namespace dima {
                 release_all();
                 first_slot = other.first_slot;
                 length = other.length;
-                other.first_slot = slot_iterator();
+                other.first_slot = nullptr;
                 other.length = 0;
             }
             return *this;
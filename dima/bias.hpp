@@ -0,0 +1,188 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/// @namespace `dima`
+/// @brief The `dima` namespace contains all classes used for the DIMA memory management system
+namespace dima {
+
+    /// @class `BiasedThreads`
+    /// @brief The registry of all threads which own the slots of biased types, see `default_policy::biased_references`. Every thread gets
+    /// a unique id the first time it needs one. A reference counted by an owner thread but released on another thread cannot be dropped
+    /// there, so it is handed to the owner instead, which drops it the next time it allocates a value of a biased type or calls `collect`.
+    /// Handing a reference over is a single push onto a lock-free list of the owner, found through its id without any lookup structure
+    class BiasedThreads {
+      public:
+        /// @var `NO_THREAD`
+        /// @brief The id of no thread at all, which is the owner of every slot whose references are all counted in the shared count
+        static constexpr uint32_t NO_THREAD = 0;
+
+        /// @brief The function which drops a handed over reference of a slot on its owner thread
+        using Release = void (*)(void *slot);
+
+        /// @function `get_current`
+        /// @brief Returns the id of the calling thread, registering the thread on its first call
+        ///
+        /// @return `uint32_t` The id of the calling thread, which is never reused by another thread
+        static inline uint32_t get_current() {
+            const uint32_t id = current_id;
+            return id != NO_THREAD ? id : enter();
+        }
+
+        /// @function `defer`
+        /// @brief Hands a reference counted by the given owner thread over to it. The reference is pushed onto the list of the owner with
+        /// a single compare and swap, which fails only if the owner thread has closed its list because it exited
+        ///
+        /// @param `owner` The id of the owner thread
+        /// @param `slot` The slot whose reference is handed over
+        /// @param `release` The function which drops the reference on the owner thread
+        /// @return `bool` Whether the reference was handed over, false if the owner thread has exited already
+        static bool defer(const uint32_t owner, void *slot, Release release) {
+            Record &record = get_record(owner);
+            // Seeing the closed marker has to acquire it, as the caller reads the local count of the exited owner thread afterwards
+            Deferred *head = record.head.load(std::memory_order_acquire);
+            if (head == get_closed()) {
+                return false;
+            }
+            Deferred *entry = new Deferred{slot, release, head};
+            while (!record.head.compare_exchange_weak(entry->next, entry, std::memory_order_release, std::memory_order_acquire)) {
+                if (entry->next == get_closed()) {
+                    delete entry;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /// @function `has_deferred`
+        /// @brief Checks whether other threads have handed references over to the calling thread
+        ///
+        /// @return `bool` Whether there are references to drop through `collect`
+        static inline bool has_deferred() {
+            const Record *record = current_record;
+            return record != nullptr && record->head.load(std::memory_order_relaxed) != nullptr;
+        }
+
+        /// @function `collect`
+        /// @brief Drops all references other threads have handed over to the calling thread, which frees the values no other thread
+        /// refers to anymore. Threads which own values but rarely allocate should call this from time to time
+        static void collect() {
+            if (current_record != nullptr) {
+                drain(current_record->head.exchange(nullptr, std::memory_order_acquire));
+            }
+        }
+
+      private:
+        /// @struct `Deferred`
+        /// @brief A reference which was handed over to its owner thread, linked to the reference handed over before it
+        struct Deferred {
+            void *slot;
+            Release release;
+            Deferred *next;
+        };
+
+        /// @struct `Record`
+        /// @brief The handed over references of a single thread, as a lock-free list which any thread pushes onto and only the owner thread
+        /// takes from. Once the thread exited the list is closed. A record is never destroyed, as other threads may still read it then
+        struct Record {
+            std::atomic<Deferred *> head = {nullptr};
+        };
+
+        /// @var `FIRST_CHUNK_SIZE`
+        /// @brief The number of records in the first chunk of the record table, every following chunk is twice as large as the one before
+        static constexpr uint32_t FIRST_CHUNK_SIZE = 1024;
+
+        /// @var `CHUNK_COUNT`
+        /// @brief The number of chunks of the record table, which together hold a record for every possible thread id
+        static constexpr uint32_t CHUNK_COUNT = 23;
+
+        /// @struct `Exit`
+        /// @brief Drops everything which was handed over to its thread when the thread ends, then closes the list of the thread and drops
+        /// what was handed over in between. References released after that are merged by the releasing thread itself, as the local counts
+        /// of an exited thread cannot change anymore
+        struct Exit {
+            ~Exit() {
+                Record *record = current_record;
+                drain(record->head.exchange(nullptr, std::memory_order_acquire));
+                // Closing the list releases the final local counts of this thread to every thread which finds the list closed
+                drain(record->head.exchange(get_closed(), std::memory_order_acq_rel));
+                current_record = nullptr;
+            }
+        };
+
+        /// @var `current_id`
+        /// @brief The id of the calling thread, `NO_THREAD` until it registered itself. It is a trivial thread local, so it stays readable
+        /// while the other thread locals of the thread are being destroyed
+        static inline thread_local uint32_t current_id = NO_THREAD;
+
+        /// @var `current_record`
+        /// @brief The record of the calling thread, nullptr until the thread registered itself and after it has exited
+        static inline thread_local Record *current_record = nullptr;
+
+        /// @var `next_id`
+        /// @brief The id the next registering thread gets
+        static inline std::atomic<uint32_t> next_id = {NO_THREAD + 1};
+
+        /// @var `chunks`
+        /// @brief The record table, the record of a thread lives at its id. The chunks are created when the first thread of their id range
+        /// registers itself and are never destroyed, as variables with static storage duration may still release references while the
+        /// program shuts down
+        static inline std::atomic<Record *> chunks[CHUNK_COUNT] = {};
+
+        /// @function `get_closed`
+        /// @brief Returns the marker which closes the list of an exited thread
+        static inline Deferred *get_closed() {
+            static Deferred closed{nullptr, nullptr, nullptr};
+            return &closed;
+        }
+
+        /// @function `get_record`
+        /// @brief Returns the record of the thread with the given id. Chunk `k` holds the ids `[FIRST_CHUNK_SIZE * (2^k - 1),
+        /// FIRST_CHUNK_SIZE * (2^(k + 1) - 1))`, so the chunk is found with a single bit scan
+        ///
+        /// @param `id` The id of a registered thread
+        /// @return `Record &` The record of the thread
+        static inline Record &get_record(const uint32_t id) {
+            const uint64_t position = uint64_t(id) / FIRST_CHUNK_SIZE + 1;
+            const uint32_t chunk = 63 - __builtin_clzll(position);
+            const uint64_t offset = uint64_t(id) - uint64_t(FIRST_CHUNK_SIZE) * ((uint64_t(1) << chunk) - 1);
+            return chunks[chunk].load(std::memory_order_acquire)[offset];
+        }
+
+        /// @function `enter`
+        /// @brief Registers the calling thread, creating the chunk of the record table its id lives in if no thread created it yet
+        ///
+        /// @return `uint32_t` The id of the calling thread
+        static uint32_t enter() {
+            const uint32_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+            const uint32_t chunk = 63 - __builtin_clzll(uint64_t(id) / FIRST_CHUNK_SIZE + 1);
+            if (chunks[chunk].load(std::memory_order_acquire) == nullptr) {
+                Record *created = new Record[size_t(FIRST_CHUNK_SIZE) << chunk];
+                Record *expected = nullptr;
+                if (!chunks[chunk].compare_exchange_strong(expected, created, std::memory_order_acq_rel)) {
+                    // Another thread of the same id range created the chunk first
+                    delete[] created;
+                }
+            }
+            current_id = id;
+            current_record = &get_record(id);
+            thread_local Exit exit;
+            return id;
+        }
+
+        /// @function `drain`
+        /// @brief Drops all references of the given list, which was taken off a record
+        ///
+        /// @param `deferred` The first reference of the list
+        static void drain(Deferred *deferred) {
+            while (deferred != nullptr) {
+                Deferred *next = deferred->next;
+                deferred->release(deferred->slot);
+                delete deferred;
+                deferred = next;
+            }
+        }
+    };
+} // namespace dima
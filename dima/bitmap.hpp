@@ -0,0 +1,607 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/// @namespace `dima`
+/// @brief The `dima` namespace contains all classes used for the DIMA memory management system
+namespace dima {
+
+    /// @class `Bitmap`
+    /// @brief A two-level occupancy bitmap. The lower level stores one bit per slot (set = occupied) in 64 bit words, the upper level (the
+    /// summary) stores one bit per word, which is set whenever that word still contains at least one free slot. All searches operate on
+    /// whole words, so finding free slots or free runs costs O(capacity / 64) word operations at worst, and full regions are skipped
+    /// through the summary at a rate of 4096 slots per summary word. The words of both levels are initialized lazily, in order, the first
+    /// time a bit in or behind them is changed, so creating a bitmap takes constant time and never touches the storage of words which are
+    /// not needed yet
+    class Bitmap {
+      public:
+        /// @var `WORD_BITS`
+        /// @brief The number of slots tracked by a single occupancy word
+        static constexpr uint32_t WORD_BITS = 64;
+
+        Bitmap() = default;
+        explicit Bitmap(const uint32_t bit_count) :
+            Bitmap(bit_count, new uint64_t[get_storage_size(bit_count)]) {
+            owned_storage.reset(words);
+        }
+
+        /// @brief Creates a bitmap inside of the given storage, which has to hold `get_storage_size(bit_count)` words and outlive the
+        /// bitmap. This lets a block keep its bitmap in the same allocation as its slots
+        Bitmap(const uint32_t bit_count, uint64_t *storage) :
+            bit_count(bit_count),
+            word_count(get_word_count(bit_count)),
+            summary_count(get_word_count(get_word_count(bit_count))),
+            words(storage),
+            summary(storage + get_word_count(bit_count)) {}
+
+        Bitmap(const Bitmap &) = delete;
+        Bitmap &operator=(const Bitmap &) = delete;
+
+        /// @function `get_storage_size`
+        /// @brief Returns how many 64 bit words a bitmap of the given number of bits needs for both of its levels
+        ///
+        /// @param `bits` The number of bits of the bitmap
+        /// @return `size_t` The number of words needed
+        static constexpr size_t get_storage_size(const uint32_t bits) {
+            return get_word_count(bits) + get_word_count(get_word_count(bits));
+        }
+
+        /// @function `get_word_count`
+        /// @brief Returns how many 64 bit words are needed to store the given number of bits
+        ///
+        /// @param `bits` The number of bits to store
+        /// @return `uint32_t` The number of words needed
+        static constexpr uint32_t get_word_count(const uint32_t bits) {
+            return (bits + WORD_BITS - 1) / WORD_BITS;
+        }
+
+        /// @function `test`
+        /// @brief Checks whether the bit at the given index is set
+        ///
+        /// @param `idx` The index of the bit to check
+        /// @return `bool` Whether the bit is set (the slot is occupied)
+        inline bool test(const uint32_t idx) const {
+            return (load_word(idx / WORD_BITS) >> (idx % WORD_BITS)) & 1;
+        }
+
+        /// @function `set`
+        /// @brief Sets the bit at the given index and updates the summary if its word became full
+        ///
+        /// @param `idx` The index of the bit to set
+        inline void set(const uint32_t idx) {
+            const uint32_t word_idx = idx / WORD_BITS;
+            initialize_words(word_idx);
+            uint64_t &word = words[word_idx];
+            word |= 1ULL << (idx % WORD_BITS);
+            if (word == ~0ULL) {
+                summary[word_idx / WORD_BITS] &= ~(1ULL << (word_idx % WORD_BITS));
+            }
+        }
+
+        /// @function `clear`
+        /// @brief Clears the bit at the given index and marks its word as non-full in the summary
+        ///
+        /// @param `idx` The index of the bit to clear
+        inline void clear(const uint32_t idx) {
+            const uint32_t word_idx = idx / WORD_BITS;
+            initialize_words(word_idx);
+            words[word_idx] &= ~(1ULL << (idx % WORD_BITS));
+            summary[word_idx / WORD_BITS] |= 1ULL << (word_idx % WORD_BITS);
+        }
+
+        /// @function `clear_mask`
+        /// @brief Clears all bits of the given mask inside of the word at the given index at once and marks the word as non-full in the
+        /// summary
+        ///
+        /// @param `word_idx` The index of the word
+        /// @param `mask` The bits of the word to clear
+        inline void clear_mask(const uint32_t word_idx, const uint64_t mask) {
+            initialize_words(word_idx);
+            words[word_idx] &= ~mask;
+            summary[word_idx / WORD_BITS] |= 1ULL << (word_idx % WORD_BITS);
+        }
+
+        /// @function `set_range`
+        /// @brief Sets all bits in the range `[start, start + length)`, whole words at a time
+        ///
+        /// @param `start` The index of the first bit to set
+        /// @param `length` The number of bits to set
+        void set_range(const uint32_t start, const uint32_t length) {
+            uint32_t idx = start;
+            const uint32_t end = start + length;
+            if (length > 0) {
+                initialize_words((end - 1) / WORD_BITS);
+            }
+            while (idx < end) {
+                const uint32_t word_idx = idx / WORD_BITS;
+                const uint32_t offset = idx % WORD_BITS;
+                const uint32_t count = std::min(WORD_BITS - offset, end - idx);
+                const uint64_t mask = (count == WORD_BITS ? ~0ULL : ((1ULL << count) - 1)) << offset;
+                uint64_t &word = words[word_idx];
+                word |= mask;
+                if (word == ~0ULL) {
+                    summary[word_idx / WORD_BITS] &= ~(1ULL << (word_idx % WORD_BITS));
+                }
+                idx += count;
+            }
+        }
+
+        /// @function `find_free_run`
+        /// @brief Finds the first run of at least `length` contiguous free bits. Fully occupied words are skipped through the summary,
+        /// runs of completely free words are counted with SIMD and runs crossing or lying inside of words are found with word-wide bit
+        /// tricks, so no single bit is ever tested on its own
+        ///
+        /// @param `length` The number of contiguous free bits to find
+        /// @return `std::optional<uint32_t>` The index of the first bit of the free run, nullopt if no such run exists
+        std::optional<uint32_t> find_free_run(const uint32_t length) const {
+            if (length == 0 || length > bit_count) {
+                return std::nullopt;
+            }
+            // The number of free bits directly before the current word
+            uint32_t run = 0;
+            uint32_t i = 0;
+            while (i < word_count) {
+                if (run == 0) {
+                    // Nothing carries over from the last word, so all full words can be skipped
+                    i = find_non_full_word(i);
+                    if (i == word_count) {
+                        break;
+                    }
+                }
+                const uint64_t word = load_word(i);
+                if (word == 0) {
+                    const uint32_t empty_words = count_empty_words(i);
+                    if (run + empty_words * WORD_BITS >= length) {
+                        return i * WORD_BITS - run;
+                    }
+                    run += empty_words * WORD_BITS;
+                    i += empty_words;
+                    continue;
+                }
+                // The free bits at the bottom of this word extend the run of the previous words
+                if (run + __builtin_ctzll(word) >= length) {
+                    return i * WORD_BITS - run;
+                }
+                // Find a run which lies completely inside of this word by and-ing the free mask with shifted versions of itself. Bit `n`
+                // of the result is set if the bits `n` to `n + length - 1` are all free
+                if (length < WORD_BITS) {
+                    uint64_t free_mask = ~word;
+                    for (uint32_t covered = 1; covered < length && free_mask != 0;) {
+                        const uint32_t shift = std::min(covered, length - covered);
+                        free_mask &= free_mask >> shift;
+                        covered += shift;
+                    }
+                    if (free_mask != 0) {
+                        return i * WORD_BITS + __builtin_ctzll(free_mask);
+                    }
+                }
+                // The free bits at the top of this word start a new run
+                run = __builtin_clzll(word);
+                i++;
+            }
+            return std::nullopt;
+        }
+
+        /// @function `get_largest_free_run`
+        /// @brief Calculates the length of the largest run of contiguous free bits
+        ///
+        /// @return `uint32_t` The length of the largest free run
+        uint32_t get_largest_free_run() const {
+            uint32_t largest = 0;
+            uint32_t run = 0;
+            for (uint32_t i = 0; i < word_count; i++) {
+                const uint64_t word = load_word(i);
+                if (word == 0) {
+                    run += WORD_BITS;
+                    continue;
+                }
+                const uint32_t low = __builtin_ctzll(word);
+                const uint32_t high = __builtin_clzll(word);
+                largest = std::max(largest, run + low);
+                // Measure the free runs between the lowest and the highest occupied bit of this word, one run at a time
+                uint64_t inner = ~word & (~0ULL << low);
+                if (high > 0) {
+                    inner &= ~0ULL >> high;
+                }
+                while (inner != 0) {
+                    const uint32_t start = __builtin_ctzll(inner);
+                    const uint32_t len = __builtin_ctzll(~(inner >> start));
+                    largest = std::max(largest, len);
+                    inner &= ~0ULL << (start + len);
+                }
+                run = high;
+            }
+            return std::max(largest, run);
+        }
+
+        /// @function `for_each_set`
+        /// @brief Calls the given function with the index of every set bit. Completely free words are skipped as a whole
+        ///
+        /// @param `func` The function to call for every set bit
+        template <typename Func> void for_each_set(Func &&func) const {
+            // Words which were never initialized have no set bits besides the ones past the end
+            for (uint32_t i = 0; i < initialized_count; i++) {
+                uint64_t word = words[i];
+                if (word == 0) {
+                    i += count_empty_words(i) - 1;
+                    continue;
+                }
+                if (i == word_count - 1 && bit_count % WORD_BITS != 0) {
+                    word &= (1ULL << (bit_count % WORD_BITS)) - 1;
+                }
+                while (word != 0) {
+                    func(i * WORD_BITS + __builtin_ctzll(word));
+                    word &= word - 1;
+                }
+            }
+        }
+
+        /// @function `find_next_set`
+        /// @brief Finds the first set bit at or after the given index. Completely free words are skipped as a whole
+        ///
+        /// @param `from` The index of the bit to start searching from
+        /// @return `std::optional<uint32_t>` The index of the first set bit, nullopt if no bit at or after `from` is set
+        std::optional<uint32_t> find_next_set(const uint32_t from) const {
+            if (from >= bit_count) {
+                return std::nullopt;
+            }
+            uint32_t i = from / WORD_BITS;
+            uint64_t word = load_word(i) & (~0ULL << (from % WORD_BITS));
+            while (word == 0) {
+                if (++i == word_count) {
+                    return std::nullopt;
+                }
+                i += count_empty_words(i);
+                if (i == word_count) {
+                    return std::nullopt;
+                }
+                word = load_word(i);
+            }
+            // The bits past the end of the bitmap are set, but they do not belong to any slot
+            const uint32_t idx = i * WORD_BITS + __builtin_ctzll(word);
+            if (idx >= bit_count) {
+                return std::nullopt;
+            }
+            return idx;
+        }
+
+      private:
+        /// @var `bit_count`
+        /// @brief The number of bits tracked by this bitmap
+        uint32_t bit_count = 0;
+
+        /// @var `word_count`
+        /// @brief The number of occupancy words
+        uint32_t word_count = 0;
+
+        /// @var `summary_count`
+        /// @brief The number of summary words
+        uint32_t summary_count = 0;
+
+        /// @var `initialized_count`
+        /// @brief The number of occupancy words which have been initialized, together with the summary words covering them. All words from
+        /// this one on are free, apart from the bits past the end of the bitmap, and their summary bits are not written yet
+        uint32_t initialized_count = 0;
+
+        /// @var `words`
+        /// @brief The occupancy words, one bit per slot
+        uint64_t *words = nullptr;
+
+        /// @var `summary`
+        /// @brief The summary level, one bit per occupancy word which is set when the word has at least one free bit. It directly follows
+        /// the occupancy words in the same storage
+        uint64_t *summary = nullptr;
+
+        /// @var `owned_storage`
+        /// @brief The storage of both levels if this bitmap allocated it itself, empty if the storage belongs to someone else
+        std::unique_ptr<uint64_t[]> owned_storage;
+
+        /// @function `load_word`
+        /// @brief Returns the occupancy word at the given index, without initializing it
+        ///
+        /// @param `word_idx` The index of the word
+        /// @return `uint64_t` The word, which for a word that was never initialized only has the bits past the end of the bitmap set
+        inline uint64_t load_word(const uint32_t word_idx) const {
+            if (word_idx < initialized_count) {
+                return words[word_idx];
+            }
+            return get_initial_word(word_idx);
+        }
+
+        /// @function `get_initial_word`
+        /// @brief Returns the value the occupancy word at the given index starts with. The bits past the end of the bitmap are marked as
+        /// occupied, this way they can never be found as free
+        ///
+        /// @param `word_idx` The index of the word
+        /// @return `uint64_t` The initial value of the word
+        inline uint64_t get_initial_word(const uint32_t word_idx) const {
+            if (word_idx == word_count - 1 && bit_count % WORD_BITS != 0) {
+                return ~0ULL << (bit_count % WORD_BITS);
+            }
+            return 0;
+        }
+
+        /// @function `initialize_words`
+        /// @brief Initializes all occupancy words up to and including the given one, together with the summary words covering them. Words
+        /// are only ever initialized once and in order, so all calls of a bitmap together cost O(capacity / 64) at most
+        ///
+        /// @param `word_idx` The index of the last word which has to be initialized
+        inline void initialize_words(const uint32_t word_idx) {
+            while (initialized_count <= word_idx) {
+                const uint32_t i = initialized_count++;
+                if (i % WORD_BITS == 0) {
+                    summary[i / WORD_BITS] = 0;
+                }
+                // A fresh word always has a free bit, the bits past the end never fill a whole word
+                words[i] = get_initial_word(i);
+                summary[i / WORD_BITS] |= 1ULL << (i % WORD_BITS);
+            }
+        }
+
+        /// @function `find_non_full_word`
+        /// @brief Finds the first word at or after the given index which has at least one free bit, using the summary level. Only the
+        /// initialized words are tracked in the summary, the first word which was never initialized always has a free bit
+        ///
+        /// @param `from` The index of the word to start searching from
+        /// @return `uint32_t` The index of the first non-full word, the word count if all remaining words are full
+        uint32_t find_non_full_word(const uint32_t from) const {
+            if (from >= initialized_count) {
+                return std::min(from, word_count);
+            }
+            uint32_t summary_idx = from / WORD_BITS;
+            const uint32_t summary_end = get_word_count(initialized_count);
+            uint64_t bits = summary[summary_idx] & (~0ULL << (from % WORD_BITS));
+            while (bits == 0) {
+                if (++summary_idx == summary_end) {
+                    return initialized_count;
+                }
+                bits = summary[summary_idx];
+            }
+            return summary_idx * WORD_BITS + __builtin_ctzll(bits);
+        }
+
+        /// @function `count_empty_words`
+        /// @brief Counts how many completely free words follow the given index (including it), comparing several words at once when
+        /// SSE2 or AVX2 is available
+        ///
+        /// @param `from` The index of the word to start counting from
+        /// @return `uint32_t` The number of consecutive completely free words
+        uint32_t count_empty_words(const uint32_t from) const {
+            const uint64_t *data = words;
+            uint32_t i = from;
+#if defined(__AVX2__)
+            for (; i + 4 <= initialized_count; i += 4) {
+                const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+                if (!_mm256_testz_si256(chunk, chunk)) {
+                    break;
+                }
+            }
+#elif defined(__SSE2__)
+            for (; i + 2 <= initialized_count; i += 2) {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(chunk, _mm_setzero_si128())) != 0xFFFF) {
+                    break;
+                }
+            }
+#endif
+            while (i < initialized_count && data[i] == 0) {
+                i++;
+            }
+            // The words which were never initialized are all free, only a last word with bits past the end is not
+            const uint32_t free_end = bit_count % WORD_BITS != 0 ? word_count - 1 : word_count;
+            if (i >= initialized_count && i < free_end) {
+                i = free_end;
+            }
+            return i - from;
+        }
+    };
+
+    /// @class `AtomicBitmap`
+    /// @brief A single-level occupancy bitmap (set = occupied) which many threads can change at once without a lock, used by concurrent
+    /// blocks (see `default_policy::concurrent_blocks`). Bits are claimed with `fetch_or` and released with `fetch_and` on whole 64 bit
+    /// words. Unlike `Bitmap` its words cannot be initialized lazily, as any thread may search any word, so creating it clears all words
+    /// up front, which costs O(capacity / 64)
+    class AtomicBitmap {
+      public:
+        explicit AtomicBitmap(const uint32_t bit_count) :
+            AtomicBitmap(bit_count, new uint64_t[get_storage_size(bit_count)]) {
+            owned_storage.reset(reinterpret_cast<uint64_t *>(words));
+        }
+
+        /// @brief Creates a bitmap inside of the given storage, which has to hold `get_storage_size(bit_count)` words and outlive the
+        /// bitmap
+        AtomicBitmap(const uint32_t bit_count, uint64_t *storage) :
+            bit_count(bit_count),
+            word_count(Bitmap::get_word_count(bit_count)),
+            words(reinterpret_cast<std::atomic<uint64_t> *>(storage)) {
+            static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "The atomic words have to fit into the plain storage words");
+            for (uint32_t i = 0; i < word_count; i++) {
+                new (&words[i]) std::atomic<uint64_t>(0);
+            }
+            // The bits past the end of the bitmap are marked as occupied, this way they can never be claimed
+            if (bit_count % Bitmap::WORD_BITS != 0) {
+                words[word_count - 1].store(~0ULL << (bit_count % Bitmap::WORD_BITS), std::memory_order_relaxed);
+            }
+        }
+
+        AtomicBitmap(const AtomicBitmap &) = delete;
+        AtomicBitmap &operator=(const AtomicBitmap &) = delete;
+
+        /// @function `get_storage_size`
+        /// @brief Returns how many 64 bit words a bitmap of the given number of bits needs
+        ///
+        /// @param `bits` The number of bits of the bitmap
+        /// @return `size_t` The number of words needed
+        static constexpr size_t get_storage_size(const uint32_t bits) {
+            return Bitmap::get_word_count(bits);
+        }
+
+        /// @function `test`
+        /// @brief Checks whether the bit at the given index is set
+        ///
+        /// @param `idx` The index of the bit to check
+        /// @return `bool` Whether the bit is set (the slot is occupied)
+        inline bool test(const uint32_t idx) const {
+            return (words[idx / Bitmap::WORD_BITS].load(std::memory_order_acquire) >> (idx % Bitmap::WORD_BITS)) & 1;
+        }
+
+        /// @function `claim`
+        /// @brief Sets one clear bit, searching the words round robin starting at the word `from`. Two threads racing for the same bit
+        /// both `fetch_or` it, the one which sees it clear in the returned word has claimed it and the other one moves on with the word it
+        /// got back. The caller has to know that a clear bit exists, otherwise this never returns
+        ///
+        /// @param `from` The index of the word to start the search at
+        /// @return `uint32_t` The index of the claimed bit
+        uint32_t claim(const uint32_t from) {
+            for (uint32_t word_idx = from < word_count ? from : 0;; word_idx = word_idx + 1 < word_count ? word_idx + 1 : 0) {
+                uint64_t word = words[word_idx].load(std::memory_order_relaxed);
+                while (word != ~0ULL) {
+                    const uint64_t bit = 1ULL << __builtin_ctzll(~word);
+                    word = words[word_idx].fetch_or(bit, std::memory_order_acquire);
+                    if ((word & bit) == 0) {
+                        return word_idx * Bitmap::WORD_BITS + __builtin_ctzll(bit);
+                    }
+                }
+            }
+        }
+
+        /// @function `clear`
+        /// @brief Clears the bit at the given index. Everything the clearing thread did to the slot before happens before the next claim
+        /// of the bit
+        ///
+        /// @param `idx` The index of the bit to clear
+        inline void clear(const uint32_t idx) {
+            words[idx / Bitmap::WORD_BITS].fetch_and(~(1ULL << (idx % Bitmap::WORD_BITS)), std::memory_order_release);
+        }
+
+        /// @function `clear_mask`
+        /// @brief Clears all bits of the given mask in the given word at once, see `clear`
+        ///
+        /// @param `word_idx` The index of the word
+        /// @param `mask` The bits to clear
+        inline void clear_mask(const uint32_t word_idx, const uint64_t mask) {
+            words[word_idx].fetch_and(~mask, std::memory_order_release);
+        }
+
+        /// @function `for_each_set`
+        /// @brief Calls the given function with the index of every set bit. The words are read one at a time, so this is only a snapshot
+        /// while other threads claim and clear bits
+        ///
+        /// @param `func` The function to call for every set bit
+        template <typename Func> void for_each_set(Func &&func) const {
+            for (uint32_t i = 0; i < word_count; i++) {
+                uint64_t word = words[i].load(std::memory_order_acquire);
+                if (i == word_count - 1 && bit_count % Bitmap::WORD_BITS != 0) {
+                    word &= (1ULL << (bit_count % Bitmap::WORD_BITS)) - 1;
+                }
+                while (word != 0) {
+                    func(i * Bitmap::WORD_BITS + __builtin_ctzll(word));
+                    word &= word - 1;
+                }
+            }
+        }
+
+      private:
+        /// @var `bit_count`
+        /// @brief The number of bits tracked by this bitmap
+        uint32_t bit_count;
+
+        /// @var `word_count`
+        /// @brief The number of occupancy words
+        uint32_t word_count;
+
+        /// @var `words`
+        /// @brief The occupancy words, one bit per slot
+        std::atomic<uint64_t> *words;
+
+        /// @var `owned_storage`
+        /// @brief The storage of the words if this bitmap allocated it itself, empty if the storage belongs to someone else
+        std::unique_ptr<uint64_t[]> owned_storage;
+    };
+
+    /// @class `BlockSet`
+    /// @brief A growable set of block ids stored as plain bits. The head uses it to index which blocks have a certain property (like
+    /// having free slots), so it can find a matching block with a few word operations instead of visiting every block
+    class BlockSet {
+      public:
+        /// @var `NONE`
+        /// @brief The value returned by `find_last` when no block id was found
+        static constexpr size_t NONE = SIZE_MAX;
+
+        /// @function `insert`
+        /// @brief Adds the given block id to this set
+        ///
+        /// @param `id` The block id to add
+        void insert(const size_t id) {
+            if (id / Bitmap::WORD_BITS >= words.size()) {
+                words.resize(id / Bitmap::WORD_BITS + 1, 0);
+            }
+            words[id / Bitmap::WORD_BITS] |= 1ULL << (id % Bitmap::WORD_BITS);
+        }
+
+        /// @function `erase`
+        /// @brief Removes the given block id from this set
+        ///
+        /// @param `id` The block id to remove
+        void erase(const size_t id) {
+            if (id / Bitmap::WORD_BITS < words.size()) {
+                words[id / Bitmap::WORD_BITS] &= ~(1ULL << (id % Bitmap::WORD_BITS));
+            }
+        }
+
+        /// @function `contains`
+        /// @brief Checks whether the given block id is part of this set
+        ///
+        /// @param `id` The block id to check
+        /// @return `bool` Whether the block id is part of this set
+        bool contains(const size_t id) const {
+            return id / Bitmap::WORD_BITS < words.size() && ((words[id / Bitmap::WORD_BITS] >> (id % Bitmap::WORD_BITS)) & 1);
+        }
+
+        /// @function `find_last`
+        /// @brief Finds the largest block id in this set which is smaller than `before`
+        ///
+        /// @param `before` The exclusive upper limit of the block id to find
+        /// @return `size_t` The largest block id smaller than `before`, `NONE` if there is none
+        size_t find_last(const size_t before = NONE) const {
+            const size_t limit = std::min(before, words.size() * Bitmap::WORD_BITS);
+            if (limit == 0) {
+                return NONE;
+            }
+            size_t word_idx = (limit - 1) / Bitmap::WORD_BITS;
+            const size_t offset = (limit - 1) % Bitmap::WORD_BITS;
+            uint64_t word = words[word_idx] & (offset == Bitmap::WORD_BITS - 1 ? ~0ULL : (1ULL << (offset + 1)) - 1);
+            while (word == 0) {
+                if (word_idx == 0) {
+                    return NONE;
+                }
+                word = words[--word_idx];
+            }
+            return word_idx * Bitmap::WORD_BITS + (Bitmap::WORD_BITS - 1 - __builtin_clzll(word));
+        }
+
+        /// @function `clear`
+        /// @brief Removes all block ids from this set
+        void clear() {
+            words.clear();
+        }
+
+      private:
+        /// @var `words`
+        /// @brief The bits of this set, one bit per block id
+        std::vector<uint64_t> words;
+    };
+} // namespace dima
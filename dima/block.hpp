@@ -1,36 +1,186 @@
 #pragma once
 
 #include "array.hpp"
+#include "bitmap.hpp"
+#include "memory.hpp"
 #include "slot.hpp"
 #include "var.hpp"
 
 #include <algorithm>
-#include <bitset>
-#include <functional>
+#include <atomic>
+#include <memory>
+#include <new>
 #include <optional>
 #include <type_traits>
-#include <vector>
 
 /// @namespace `dima`
 /// @brief The `dima` namespace contains all classes used for the DIMA memory management system
 namespace dima {
 
+    template <typename T, typename> class Block;
+
+    /// @class `BlockOwner`
+    /// @brief The interface of everything which owns blocks (the heads). A block only keeps a single pointer to its owner, through which it
+    /// lets the owner know of the changes the owner keeps track of
+    template <typename T> class BlockOwner {
+      public:
+        /// @function `block_emptied`
+        /// @brief This function gets called from a block which has become empty. The owner may destroy the block right away
+        ///
+        /// @param `empty_block` The block which has become empty
+        virtual void block_emptied(Block<T, void> *empty_block) = 0;
+
+        /// @function `block_gained_space`
+        /// @brief This function gets called from a block which a freed slot made non-full or whose largest free run hint grew
+        ///
+        /// @param `block` The block which gained free space
+        virtual void block_gained_space(Block<T, void> *block) = 0;
+
+        /// @function `slot_released`
+        /// @brief This function gets called instead of `Block::free_slot` when a slot of a block which hands its released slots to its
+        /// owner is released, see `Block::set_owner`
+        ///
+        /// @param `block` The block the released slot belongs to
+        /// @param `slot` The released slot
+        virtual void slot_released([[maybe_unused]] Block<T, void> *block, [[maybe_unused]] Slot<T, void> *slot) {}
+
+      protected:
+        ~BlockOwner() = default;
+    };
+
     /// @class `Block`
     /// @brief A memory block containing multiple DIMA slots
     template <typename T, typename = std::enable_if_t<std::is_class_v<T>>> //
-    class Block {
+    class Block final : public SlotOwner<T> {
       public:
+        /// @var `NO_SLOT`
+        /// @brief The index marking the end of the free list and the absence of an empty slot, which no slot can have as block capacities
+        /// stay below `MAX_BLOCK_CAPACITY`
+        static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+        /// @var `CONCURRENT`
+        /// @brief Whether any number of threads reserve and free slots of this block at once, see `default_policy::concurrent_blocks`
+        static constexpr bool CONCURRENT = type_policy<T>::type::concurrent_blocks;
+
+        /// @brief The occupancy bitmap of this block, concurrent blocks claim and clear their bits atomically
+        using Occupancy = std::conditional_t<CONCURRENT, AtomicBitmap, Bitmap>;
+
+        /// @brief The function which gives the memory of a block back to where it came from, see the memory providers
+        using Deallocate = void (*)(void *memory, size_t size, size_t alignment);
+
         Block(const uint32_t block_id, const size_t n) :
             block_id(block_id),
             capacity(n),
-            slots(n) {
-            free_slots.resize((n + BASE_SIZE - 1) / BASE_SIZE);
-            for (auto &slot : slots) {
-                slot.on_free_callback = [this](Slot<T> *freed_slot) { this->slot_freed(freed_slot); };
-            }
+            largest_run_hint(n),
+            slots(this, n),
+            occupancy(n) {}
+
+        /// @function `create`
+        /// @brief Creates a block in a single allocation from the memory provider `Memory`, which holds the block itself, directly
+        /// followed by its occupancy bitmap and its slots. The allocation is aligned to at least a cache line, and creating a block this
+        /// way costs exactly one allocation and constant time otherwise, as the slots and the bitmap words are only initialized once the
+        /// block hands them out. Only concurrent blocks clear all of their bitmap words up front, see `AtomicBitmap`
+        ///
+        /// @param `block_id` The id of the block
+        /// @param `n` The capacity of the block
+        /// @return `std::unique_ptr<Block<T>>` The created block
+        template <typename Memory = heap_memory> static std::unique_ptr<Block<T>> create(const uint32_t block_id, const size_t n) {
+            const size_t size = get_memory_size(n);
+            return create_in(Memory::allocate(size, get_alignment()), size, &Memory::deallocate, block_id, n);
+        }
+
+        /// @function `create_in`
+        /// @brief Creates a block inside of the given memory, which has to be aligned to `get_alignment()` and hold `get_memory_size(n)`
+        /// bytes. The memory is handed back through `deallocate` once the block is destroyed
+        ///
+        /// @param `memory` The memory to create the block in
+        /// @param `size` The size of the memory
+        /// @param `deallocate` The function which gives the memory back
+        /// @param `block_id` The id of the block
+        /// @param `n` The capacity of the block
+        /// @return `std::unique_ptr<Block<T>>` The created block
+        static std::unique_ptr<Block<T>> create_in(void *memory, const size_t size, Deallocate deallocate, const uint32_t block_id,
+            const size_t n) {
+            std::byte *block_memory = place_allocation(memory, size, deallocate);
+            return std::unique_ptr<Block<T>>(new (block_memory) Block(block_id, n, block_memory));
         }
 
+        /// @function `get_memory_size`
+        /// @brief Returns the number of bytes a block with the given capacity needs from its memory provider
+        ///
+        /// @param `n` The capacity of the block
+        /// @return `size_t` The number of bytes needed
+        static constexpr size_t get_memory_size(const size_t n) {
+            return get_alignment() + get_allocation_size(n);
+        }
+
+        /// @function `get_alignment`
+        /// @brief Returns the alignment of every block allocation, which fits both the block itself and its slots
+        static constexpr size_t get_alignment() {
+            return alignof(Block) > SlotArray<T>::ALIGNMENT ? alignof(Block) : SlotArray<T>::ALIGNMENT;
+        }
+
+        static void *operator new(const size_t size) {
+            return place_allocation(heap_memory::allocate(get_alignment() + size, get_alignment()), get_alignment() + size,
+                &heap_memory::deallocate);
+        }
+
+        static void *operator new(const size_t, void *memory) noexcept {
+            return memory;
+        }
+
+        static void operator delete(void *ptr) {
+            // The allocation record lives outside of the block object, so it can still be read after the block has been destroyed
+            const Allocation allocation = *(reinterpret_cast<Allocation *>(ptr) - 1);
+            allocation.deallocate(static_cast<std::byte *>(ptr) - get_alignment(), allocation.size, get_alignment());
+        }
+
+        static void operator delete(void *, void *) noexcept {}
+
       private:
+        Block(const uint32_t block_id, const size_t n, std::byte *memory) :
+            block_id(block_id),
+            capacity(n),
+            largest_run_hint(n),
+            slots(this, n, memory + get_slots_offset(n)),
+            occupancy(n, reinterpret_cast<uint64_t *>(memory + sizeof(Block))) {}
+
+        /// @struct `Allocation`
+        /// @brief The record of where the memory of a block came from. It is stored directly in front of every block which lives on the
+        /// heap, so a block always goes back to the memory provider it was taken from
+        struct Allocation {
+            Deallocate deallocate;
+            size_t size;
+        };
+
+        /// @function `place_allocation`
+        /// @brief Writes the allocation record to the start of the given memory and returns where the block itself starts. The record
+        /// takes up a whole alignment unit, so the block behind it stays aligned
+        ///
+        /// @param `memory` The memory of the block, including the space of the record
+        /// @param `size` The size of the memory
+        /// @param `deallocate` The function which gives the memory back
+        /// @return `std::byte *` The start of the block
+        static std::byte *place_allocation(void *memory, const size_t size, Deallocate deallocate) {
+            static_assert(sizeof(Allocation) <= alignof(Block), "The allocation record has to fit in front of the block");
+            std::byte *block_memory = static_cast<std::byte *>(memory) + get_alignment();
+            new (reinterpret_cast<Allocation *>(block_memory) - 1) Allocation{deallocate, size};
+            return block_memory;
+        }
+
+        /// @function `get_slots_offset`
+        /// @brief Returns the offset of the slots of a block created through `create` from the start of its allocation
+        static constexpr size_t get_slots_offset(const size_t n) {
+            const size_t bitmap_end = sizeof(Block) + Occupancy::get_storage_size(n) * sizeof(uint64_t);
+            return (bitmap_end + SlotArray<T>::ALIGNMENT - 1) / SlotArray<T>::ALIGNMENT * SlotArray<T>::ALIGNMENT;
+        }
+
+        /// @function `get_allocation_size`
+        /// @brief Returns the size of the single allocation of a block created through `create`
+        static constexpr size_t get_allocation_size(const size_t n) {
+            return get_slots_offset(n) + SlotArray<T>::get_allocation_size(n);
+        }
+
         /// @var `block_id`
         /// @brief The id of this block. Is also equal to the index of this block in the blocks vector
         uint32_t block_id;
@@ -40,66 +190,107 @@ namespace dima {
         uint32_t capacity = 0;
 
         /// @var `occupied_slots`
-        /// @brief The number of occupied slots within this block
+        /// @brief The number of occupied slots within this block. Concurrent blocks count them in `claimed_slots` instead
         uint32_t occupied_slots = 0;
 
-        //// @var `pinned_count`
-        /// @brief The number of pinned slots within this block
+        /// @var `pinned_count`
+        /// @brief The number of pinned slots within this block, compaction never empties a block with pinned slots
         uint32_t pinned_count = 0;
 
-        /// @var `last_non_full_set`
-        /// @brief A simple number to cache what the last non-full slot is, all slots to the left of this index are considered full. This
-        /// variable always "points" to the first non-full bitset
-        uint32_t last_non_full_set = 0;
+        /// @var `free_head`
+        /// @brief The index of the first slot in the intrusive free list of this block, `NO_SLOT` if the free list is empty. The free list
+        /// only contains slots which have been used and freed again, all slots at or after `bump_index` were never touched
+        uint32_t free_head = NO_SLOT;
 
-        /// @var `slots`
-        /// @brief A list of all slots this block contains
-        std::vector<Slot<T>> slots;
+        /// @var `bump_index`
+        /// @brief The index of the first slot which has never been handed out. All slots from this index up to the capacity are free, are
+        /// not part of the free list and are not constructed yet, so their memory stays untouched until the bump index reaches them
+        uint32_t bump_index = 0;
+
+        /// @var `largest_run_hint`
+        /// @brief An upper bound of the largest run of contiguous free slots in this block. It is widened in O(1) when slots are freed and
+        /// is only recalculated exactly when an array allocation fails in this block
+        uint32_t largest_run_hint = 0;
+
+        /// @var `incarnation_counter`
+        /// @brief The number of block incarnations of this type ever started, used to give every incarnation a unique number
+        static inline std::atomic<uint64_t> incarnation_counter = {0};
 
-        /// @var `free_slots`
-        /// @brief A vector to track the free slots to drastrically reduce the number of times `find_empty_slot` needs to be
-        /// called
-        std::vector<std::bitset<BASE_SIZE>> free_slots;
+        /// @var `incarnation`
+        /// @brief The unique number of the current incarnation of this block. A new incarnation starts whenever this block becomes empty,
+        /// as its slots are handed out anew from then on, so weak variables of earlier incarnations never accept them again. It is read
+        /// by upgrades which do not hold the blocks mutex, see `Head::upgrade`
+        std::atomic<uint64_t> incarnation = {incarnation_counter++};
 
-        /// @var `on_empty_callback`
-        /// @brief The callback that gets executed when this block becomes empty
-        std::function<void(Block<T> *)> on_empty_callback;
+        /// @var `constructed_count`
+        /// @brief The number of slots which have been constructed at some point. Only types with weak references keep track of it, as
+        /// their slots are never constructed again once a new incarnation starts, an upgrade may look at them at any time
+        uint32_t constructed_count = 0;
+
+        /// @var `slots`
+        /// @brief All slots this block contains
+        SlotArray<T> slots;
+
+        /// @var `occupancy`
+        /// @brief The occupancy bitmap of all slots in this block, used to find contiguous free runs for arrays and to skip empty regions
+        /// when iterating over all occupied slots. Concurrent blocks find their free slots through it too
+        Occupancy occupancy;
+
+        /// @var `owner`
+        /// @brief The owner of this block, which is let know when this block becomes empty or gains free space. A block without an owner
+        /// lets nobody know
+        BlockOwner<T> *owner = nullptr;
+
+        /// @var `release_to_owner`
+        /// @brief Whether released slots of this block are handed to the owner instead of `free_slot`. It lets the head decide when a
+        /// released slot is given back to this block, for example to keep it in a thread cache first
+        bool release_to_owner = false;
+
+        /// @var `remote_free_head`
+        /// @brief The index of the first slot of the remote free list, `NO_SLOT` if it is empty. The remote free list is a lock-free stack
+        /// which any thread can push released slots onto without touching any other metadata of this block, which is why it lives on its
+        /// own cache line. Slots on it still count as occupied until they are taken off again
+        alignas(64) std::atomic<uint32_t> remote_free_head = {NO_SLOT};
+
+        /// @var `claimed_slots`
+        /// @brief The number of occupied slots of a concurrent block. A slot is counted before its bit is claimed and only uncounted after
+        /// its bit is cleared again, so every thread which got to count a slot is sure to find a clear bit. It shares the cache line of
+        /// the remote free list, which concurrent blocks never use
+        std::atomic<uint32_t> claimed_slots = {0};
+
+        /// @var `search_word`
+        /// @brief The occupancy word of a concurrent block the last slot was claimed from, where the next search starts. It is only a
+        /// hint, so it is read and written relaxed
+        std::atomic<uint32_t> search_word = {0};
 
       public:
-        /// @function `set_empty_callback`
-        /// @brief Sets the callback function of this block to execute when this block becommes empty
+        /// @var `next_remote_block`
+        /// @brief The next block in the head's list of blocks with a non-empty remote free list
+        Block<T> *next_remote_block = nullptr;
+
+        /// @function `set_owner`
+        /// @brief Sets the owner of this block, see `BlockOwner`
         ///
-        /// @param `callback` The function to execute when this block becomes empty
-        void set_empty_callback(std::function<void(Block<T> *)> callback) {
-            on_empty_callback = std::move(callback);
+        /// @param `new_owner` The owner of this block
+        /// @param `release` Whether released slots of this block are handed to the owner instead of `free_slot`
+        void set_owner(BlockOwner<T> *new_owner, const bool release) {
+            owner = new_owner;
+            release_to_owner = release;
         }
 
         /// @function `find_empty_slot`
-        /// @brief Finds the index of the next empty slot within this block, or nullopt if this block is full
+        /// @brief Finds the index of the next empty slot within this block in constant time. Previously freed slots are reused first (from
+        /// the free list), only then the never touched slots behind the bump index are handed out
         ///
-        /// @return `int` The index of the next empy slot within this block, -1 if this block is full
-        int find_empty_slot() {
-            if (occupied_slots == capacity) {
-                return -1;
+        /// @return `uint32_t` The index of the next empy slot within this block, `NO_SLOT` if this block is full
+        uint32_t find_empty_slot() const {
+            if (free_head != NO_SLOT) {
+                return free_head;
             }
-            const size_t free_slots_size = free_slots.size();
-            for (size_t i = last_non_full_set; i < free_slots_size; i++) {
-                auto &set = free_slots[i];
-                // Skip if all bits are 1 (all occupied)
-                if (set.all()) {
-                    last_non_full_set = i;
-                    continue;
-                }
-
-                // Find the first 0 bit
-                const uint64_t data = set.to_ullong();
-                uint64_t inverted = ~data;
-                // Mask off any bits beyond BASE_SIZE
-                inverted &= (1ULL << BASE_SIZE) - 1;
-                const unsigned long bit_idx = __builtin_ctzl(inverted);
-                return i * BASE_SIZE + bit_idx;
+            if (bump_index < capacity) {
+                return bump_index;
             }
-            return -1;
+            return NO_SLOT;
         }
 
         /// @function `allocate`
@@ -109,14 +300,75 @@ namespace dima {
         /// @param `args` The arguments with which to create the type T slot
         /// @return `std::optional<Var<T>>` A variable node to the allocated object of type `T`, nullopt if this block is full
         template <typename... Args> std::optional<Var<T>> allocate(Args &&...args) {
-            int idx = find_empty_slot();
-            if (idx < 0) {
+            Slot<T> *slot = reserve_slot();
+            if (slot == nullptr) {
                 return std::nullopt;
             }
-            slots[idx].allocate(std::forward<Args>(args)...);
-            free_slots[idx / BASE_SIZE][idx % BASE_SIZE] = true;
-            occupied_slots++;
-            return Var<T>(&slots[idx]);
+            try {
+                slot->allocate(std::forward<Args>(args)...);
+            } catch (...) {
+                // A throwing constructor leaves the slot empty, so it is handed back instead of staying reserved forever
+                free_slot(slot);
+                throw;
+            }
+            return Var<T>(slot);
+        }
+
+        /// @function `reserve_slot`
+        /// @brief Takes the next empty slot out of this block without constructing a value in it. The slot counts as occupied for this
+        /// block until it is handed back through `free_slot`
+        ///
+        /// @return `Slot<T> *` The reserved slot, nullptr if this block is full
+        Slot<T> *reserve_slot() {
+            if constexpr (CONCURRENT) {
+                return claim_concurrent();
+            } else {
+                const uint32_t idx = find_empty_slot();
+                if (idx == NO_SLOT) {
+                    return nullptr;
+                }
+                claim_slot(idx);
+                occupancy.set(idx);
+                occupied_slots++;
+                return &slots[idx];
+            }
+        }
+
+        /// @function `reserve_slots`
+        /// @brief Takes up to `n` empty slots out of this block at once without constructing values in them, like `reserve_slot`. Freed
+        /// slots are taken from the free list first, the rest is a single run of never touched slots behind the bump index, which is
+        /// marked in the occupancy bitmap whole words at a time
+        ///
+        /// @param `reserved` The array the reserved slots are written to, it has to hold at least `n` slots
+        /// @param `n` The number of slots to reserve at most
+        /// @return `uint32_t` The number of reserved slots, less than `n` if this block ran full
+        uint32_t reserve_slots(Slot<T> **reserved, const uint32_t n) {
+            uint32_t count = 0;
+            if constexpr (CONCURRENT) {
+                // Other threads claim slots in between, so there is no run of never touched slots to take at once
+                while (count < n && (reserved[count] = claim_concurrent()) != nullptr) {
+                    count++;
+                }
+            } else {
+                while (count < n && free_head != NO_SLOT) {
+                    const uint32_t idx = free_head;
+                    claim_slot(idx);
+                    occupancy.set(idx);
+                    reserved[count++] = &slots[idx];
+                }
+                const uint32_t run = std::min(n - count, capacity - bump_index);
+                if (run > 0) {
+                    const uint32_t first = bump_index;
+                    for (uint32_t idx = first; idx < first + run; idx++) {
+                        init_slot(idx);
+                        reserved[count++] = &slots[idx];
+                    }
+                    bump_index = first + run;
+                    occupancy.set_range(first, run);
+                }
+                occupied_slots += count;
+            }
+            return count;
         }
 
         /// @function `get_id`
@@ -143,73 +395,302 @@ namespace dima {
             }
 
             // Find a contiguous space large enough
-            uint32_t contiguous_count = 0;
-            uint32_t start_position = 0;
-
-            // Scan through bitsets to find a contiguous region
-            for (uint32_t i = 0; i < free_slots.size(); i++) {
-                const std::bitset<BASE_SIZE> &set = free_slots[i];
-
-                // Process each bit in the current bitset
-                for (uint32_t j = 0; j < BASE_SIZE; j++) {
-                    uint32_t actual_idx = i * BASE_SIZE + j;
-                    if (actual_idx >= capacity)
-                        break; // Don't go beyond capacity
-
-                    if (!set[j]) { // If slot is free
-                        if (contiguous_count == 0) {
-                            start_position = actual_idx;
-                        }
-                        contiguous_count++;
-
-                        if (contiguous_count == required) {
-                            // Found enough contiguous space
-
-                            // Allocate the slots (skip the first padding slot)
-                            for (uint32_t k = 1; k <= length; k++) {
-                                const uint32_t idx = start_position + k;
-                                free_slots[idx / BASE_SIZE][idx % BASE_SIZE] = true;
-                                slots[idx].allocate(std::forward<Args>(args)...);
-                            }
-
-                            // Update occupied slots count
-                            occupied_slots += length;
-
-                            // Create and return the Array
-                            return Array<T>(slots.begin() + start_position + 1, length);
-                        }
-                    } else {
-                        // Reset counter when we encounter an occupied slot
-                        contiguous_count = 0;
-                    }
+            const std::optional<uint32_t> start_position = occupancy.find_free_run(required);
+            if (!start_position.has_value()) {
+                // The hint was too optimistic, so it is recalculated to keep the head from trying this block again
+                largest_run_hint = occupancy.get_largest_free_run();
+                return std::nullopt;
+            }
+
+            // Allocate the slots (skip the first padding slot)
+            const uint32_t first = start_position.value() + 1;
+            uint32_t idx = first;
+            try {
+                for (; idx < first + length; idx++) {
+                    claim_slot(idx);
+                    slots[idx].allocate(std::forward<Args>(args)...);
+                    slots[idx].mark_array_element(idx == first);
                 }
+            } catch (...) {
+                // The elements constructed before the throwing one are destroyed again, and all claimed slots go back to the free list
+                for (uint32_t claimed = first; claimed < idx; claimed++) {
+                    slots[claimed].discard();
+                    push_free(claimed);
+                }
+                push_free(idx);
+                if (occupied_slots == 0) {
+                    // The array was the first allocation of this block, so the block is handed to the head just like any emptied block
+                    become_empty();
+                }
+                throw;
             }
+            occupancy.set_range(first, length);
+            occupied_slots += length;
+            return Array<T>(&slots[first], length);
+        }
 
-            // No suitable contiguous space found
-            return std::nullopt;
+        /// @function `free_slot`
+        /// @brief Hands a slot of this block back as free, making it available for the next allocation
+        ///
+        /// @param `freed_slot` The empty slot to give back to this block
+        /// @return `bool` Whether this block became empty and its owner has been notified, nothing of this block may be touched then
+        bool free_slot(Slot<T> *freed_slot) {
+            const uint32_t idx = freed_slot->index;
+            // Mark the slot as free and hand it back to the free list
+            occupancy.clear(idx);
+            if constexpr (CONCURRENT) {
+                return uncount_concurrent(1);
+            }
+            push_free(idx);
+            const bool was_full = occupied_slots == capacity;
+            occupied_slots--;
+            if (occupied_slots == 0 && become_empty()) {
+                return true;
+            }
+            // The freed slot can at most join two runs of the old largest length, and no run can be longer than the free slot count
+            const uint32_t run = std::min(largest_run_hint * 2 + 1, capacity - occupied_slots);
+            const bool run_grew = run > largest_run_hint;
+            if (run_grew) {
+                largest_run_hint = run;
+            }
+            if ((was_full || run_grew) && owner != nullptr) {
+                // Notify that this block has more free space now
+                owner->block_gained_space(this);
+            }
+            return false;
+        }
+
+        /// @function `free_slots`
+        /// @brief Hands many freed slots of this block back at once, see `free_slot`. The occupancy bits are cleared a whole word at a
+        /// time, and the counters of this block are only updated and its owner is only notified once for all of them. If this block hands
+        /// its released slots to its owner, every slot is passed to the owner instead
+        ///
+        /// @param `freed_slots` The empty slots to give back to this block, ideally in the order of their indices
+        /// @param `count` The number of slots
+        void free_slots(Slot<T> *const *freed_slots, const uint32_t count) {
+            if (release_to_owner) {
+                for (uint32_t i = 0; i < count; i++) {
+                    owner->slot_released(this, freed_slots[i]);
+                }
+                return;
+            }
+            uint32_t word_idx = freed_slots[0]->index / Bitmap::WORD_BITS;
+            uint64_t mask = 0;
+            for (uint32_t i = 0; i < count; i++) {
+                const uint32_t idx = freed_slots[i]->index;
+                if (idx / Bitmap::WORD_BITS != word_idx) {
+                    occupancy.clear_mask(word_idx, mask);
+                    word_idx = idx / Bitmap::WORD_BITS;
+                    mask = 0;
+                }
+                mask |= 1ULL << (idx % Bitmap::WORD_BITS);
+                if constexpr (!CONCURRENT) {
+                    push_free(idx);
+                }
+            }
+            occupancy.clear_mask(word_idx, mask);
+            if constexpr (CONCURRENT) {
+                uncount_concurrent(count);
+            } else {
+                const bool was_full = occupied_slots == capacity;
+                occupied_slots -= count;
+                if (occupied_slots == 0 && become_empty()) {
+                    return;
+                }
+                // Every freed slot can at most double the old largest run (plus one), and no run can be longer than the free slot count
+                const uint64_t free_count = capacity - occupied_slots;
+                uint64_t run = largest_run_hint;
+                for (uint32_t i = 0; i < count && run < free_count; i++) {
+                    run = run * 2 + 1;
+                }
+                run = std::min(run, free_count);
+                const bool run_grew = run > largest_run_hint;
+                if (run_grew) {
+                    largest_run_hint = static_cast<uint32_t>(run);
+                }
+                if ((was_full || run_grew) && owner != nullptr) {
+                    owner->block_gained_space(this);
+                }
+            }
+        }
+
+        /// @function `push_remote_free`
+        /// @brief Pushes a released slot onto the remote free list of this block, which is safe to call from any thread at any time
+        ///
+        /// @param `released_slot` The released slot to push
+        /// @return `bool` Whether the remote free list was empty before, in that case the caller has to let the head know of this block
+        bool push_remote_free(Slot<T> *released_slot) {
+            const uint32_t idx = released_slot->index;
+            uint32_t head = remote_free_head.load(std::memory_order_relaxed);
+            do {
+                slots.get_value(idx).link.next = head;
+            } while (!remote_free_head.compare_exchange_weak(head, idx, std::memory_order_acq_rel, std::memory_order_relaxed));
+            return head == NO_SLOT;
+        }
+
+        /// @function `take_remote_frees`
+        /// @brief Takes the whole remote free list of this block at once. The taken slots are linked through `Slot::link.next` and still
+        /// count as occupied
+        ///
+        /// @return `uint32_t` The index of the first taken slot, `NO_SLOT` if the remote free list was empty
+        uint32_t take_remote_frees() {
+            // Also a release, so the taker's reads of `next_remote_block` happen before the next pusher which finds the list empty
+            return remote_free_head.exchange(NO_SLOT, std::memory_order_acq_rel);
+        }
+
+        /// @function `get_slot`
+        /// @brief Returns the slot at the given index
+        ///
+        /// @param `idx` The index of the slot
+        /// @return `Slot<T> *` The slot at the given index
+        Slot<T> *get_slot(const uint32_t idx) {
+            return &slots[idx];
         }
 
       private:
+        /// @function `push_free`
+        /// @brief Pushes the slot at the given index to the front of the free list
+        ///
+        /// @param `idx` The index of the slot to push onto the free list
+        void push_free(const uint32_t idx) {
+            slots.get_value(idx).link = {NO_SLOT, free_head};
+            if (free_head != NO_SLOT) {
+                slots.get_value(free_head).link.prev = idx;
+            }
+            free_head = idx;
+        }
+
+        /// @function `claim_concurrent`
+        /// @brief Reserves a slot of a concurrent block without any lock. The slot is counted first, which fails once this block is full,
+        /// and then a clear bit is claimed in the occupancy bitmap, starting at the word the last slot was claimed from
+        ///
+        /// @return `Slot<T> *` The reserved slot, nullptr if this block is full
+        Slot<T> *claim_concurrent() {
+            uint32_t count = claimed_slots.load(std::memory_order_relaxed);
+            do {
+                if (count == capacity) {
+                    return nullptr;
+                }
+            } while (!claimed_slots.compare_exchange_weak(count, count + 1, std::memory_order_acquire, std::memory_order_relaxed));
+            const uint32_t from = search_word.load(std::memory_order_relaxed);
+            const uint32_t idx = occupancy.claim(from);
+            if (idx / Bitmap::WORD_BITS != from) {
+                search_word.store(idx / Bitmap::WORD_BITS, std::memory_order_relaxed);
+            }
+            // The slot is constructed anew on every claim, nobody else can reach it until the claiming thread hands it out
+            return &slots.init(idx);
+        }
+
+        /// @function `uncount_concurrent`
+        /// @brief Uncounts freed slots of a concurrent block without any lock, after their bits have been cleared. Only the free which
+        /// lowers the count to zero lets the owner know that this block became empty, so the owner hears of every emptying exactly once.
+        /// The owner must not destroy the block then, as other threads may already be claiming its slots again
+        ///
+        /// @param `count` The number of freed slots
+        /// @return `bool` Whether this block became empty and its owner has been notified
+        bool uncount_concurrent(const uint32_t count) {
+            const uint32_t previous = claimed_slots.fetch_sub(count, std::memory_order_acq_rel);
+            if (owner == nullptr) {
+                return false;
+            }
+            if (previous == count) {
+                owner->block_emptied(this);
+                return true;
+            }
+            if (previous == capacity) {
+                owner->block_gained_space(this);
+            }
+            return false;
+        }
+
+        /// @function `become_empty`
+        /// @brief Starts this block over once none of its slots is occupied anymore and lets its owner know that it is empty. The owner may
+        /// destroy this block right away, so nothing of it may be touched once this returned true
+        ///
+        /// @return `bool` Whether the owner has been notified
+        bool become_empty() {
+            // An empty block starts over from its first slot, so if it is kept alive it hands out its slots in address order again
+            free_head = NO_SLOT;
+            bump_index = 0;
+            largest_run_hint = capacity;
+            if constexpr (Slot<T>::WEAK) {
+                incarnation.store(incarnation_counter++, std::memory_order_release);
+            }
+            if (owner != nullptr) {
+                // Notify that this block is now empty
+                owner->block_emptied(this);
+                return true;
+            }
+            return false;
+        }
+
+        /// @function `claim_slot`
+        /// @brief Removes the free slot at the given index from the free list, or advances the bump index past it if it was never touched.
+        /// Never touched slots which get skipped over by the bump index are pushed onto the free list, so no free slot is ever lost
+        ///
+        /// @param `idx` The index of the free slot to claim
+        void claim_slot(const uint32_t idx) {
+            if (idx >= bump_index) {
+                // The slots are constructed the first time the bump index passes them
+                while (bump_index < idx) {
+                    init_slot(bump_index);
+                    push_free(bump_index++);
+                }
+                init_slot(idx);
+                bump_index = idx + 1;
+                return;
+            }
+            const FreeLink link = slots.get_value(idx).link;
+            if (link.prev != NO_SLOT) {
+                slots.get_value(link.prev).link.next = link.next;
+            } else {
+                free_head = link.next;
+            }
+            if (link.next != NO_SLOT) {
+                slots.get_value(link.next).link.prev = link.prev;
+            }
+        }
+
+        /// @function `init_slot`
+        /// @brief Constructs the slot at the given index before it is handed out for the first time in the current incarnation. The slots
+        /// of a type with weak references are only constructed once, as an upgrade may still retain or read the generation of a slot of an
+        /// earlier incarnation while it runs, see `Head::upgrade`
+        ///
+        /// @param `idx` The index of the slot to construct
+        inline void init_slot(const uint32_t idx) {
+            if constexpr (Slot<T>::WEAK) {
+                if (idx < constructed_count) {
+                    return;
+                }
+                constructed_count = idx + 1;
+            }
+            slots.init(idx);
+        }
+
         /// @function `slot_freed`
         /// @brief This function gets called from a slot that has been freed
         ///
         /// @param `freed_slot` The slot which has been freed;
-        void slot_freed(Slot<T> *freed_slot) {
-            // Calculate the index by finding the offset from the start of the slots vector
-            uint32_t idx = freed_slot - &slots[0];
-
-            // Mark the slot as free
-            const uint32_t free_set_idx = idx / BASE_SIZE;
-            free_slots[free_set_idx][idx & BASE_SIZE] = false;
-
-            // Update the index tracking variable for cache optimization
-            if (free_set_idx < last_non_full_set) {
-                last_non_full_set = free_set_idx;
+        /// @return `bool` Whether this block became empty, see `free_slot`
+        bool slot_freed(Slot<T> *freed_slot) override {
+            if (release_to_owner) {
+                // The owner keeps the slot, so this block stays occupied
+                owner->slot_released(this, freed_slot);
+                return false;
             }
-            occupied_slots--;
-            if (occupied_slots == 0 && on_empty_callback) {
-                // Notif that this block is now empty
-                on_empty_callback(this);
+            return free_slot(freed_slot);
+        }
+
+        /// @function `slot_pinned`
+        /// @brief This function gets called from a slot of a compactable type which has been pinned or unpinned
+        ///
+        /// @param `pinned_slot` The slot which has been pinned or unpinned
+        /// @param `pinned` Whether the slot is pinned now
+        void slot_pinned(Slot<T> *, const bool pinned) override {
+            if (pinned) {
+                pinned_count++;
+            } else {
+                pinned_count--;
             }
         }
 
@@ -221,6 +702,9 @@ namespace dima {
         ///
         /// @return `size_t` The number of occupied slots in this block
         size_t get_allocation_count() {
+            if constexpr (CONCURRENT) {
+                return claimed_slots.load(std::memory_order_acquire);
+            }
             return occupied_slots;
         }
 
@@ -229,7 +713,40 @@ namespace dima {
         ///
         /// @return `size_t` The number of free slots in this block
         size_t get_free_count() {
-            return capacity - occupied_slots;
+            return capacity - get_allocation_count();
+        }
+
+        /// @function `get_largest_free_run_hint`
+        /// @brief Returns an upper bound of the largest run of contiguous free slots in this block
+        ///
+        /// @return `size_t` The upper bound of the largest free run in this block
+        size_t get_largest_free_run_hint() {
+            return largest_run_hint;
+        }
+
+        /// @function `get_pinned_count`
+        /// @brief Returns the number of pinned slots
+        ///
+        /// @return `size_t` The number of pinned slots in this block
+        size_t get_pinned_count() {
+            return pinned_count;
+        }
+
+        /// @function `find_occupied_slot`
+        /// @brief Finds the first occupied slot at or after the given index
+        ///
+        /// @param `from` The index of the slot to start searching from
+        /// @return `std::optional<uint32_t>` The index of the first occupied slot, nullopt if there is none
+        std::optional<uint32_t> find_occupied_slot(const uint32_t from) {
+            return occupancy.find_next_set(from);
+        }
+
+        /// @function `get_incarnation`
+        /// @brief Returns the unique number of the current incarnation of this block, see `incarnation`
+        ///
+        /// @return `uint64_t` The number of the current incarnation
+        uint64_t get_incarnation() const {
+            return incarnation.load(std::memory_order_acquire);
         }
 
         /// @function `get_capacity`
@@ -245,11 +762,12 @@ namespace dima {
         ///
         /// @param `func` The function to apply
         template <typename Func> void apply_to_all_slots(Func &&func) {
-            for (auto &slot : slots) {
-                if (slot.is_occupied()) {
-                    std::forward<Func>(func)(reinterpret_cast<T &>(slot.value));
+            occupancy.for_each_set([this, &func](const uint32_t idx) {
+                // Reserved slots are marked in the occupancy bitmap too, but they do not contain a value yet
+                if (slots[idx].is_occupied()) {
+                    func(reinterpret_cast<T &>(slots.get_value(idx).value));
                 }
-            }
+            });
         }
     };
 } // namespace dima
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/// @namespace `dima`
+/// @brief The `dima` namespace contains all classes used for the DIMA memory management system
+namespace dima {
+
+    /// @class `BlockTable`
+    /// @brief The table of all blocks of a head, indexed by the block id. The table is a fixed size directory of segments, where every
+    /// segment is twice as large as the one before it. Segments are only ever added, never moved or freed while the table exists, so any
+    /// number of threads can read the table wait-free while it grows and shrinks. Writers (growing, shrinking, creating and destroying
+    /// blocks) have to be serialized with each other by the caller
+    template <typename BlockT> class BlockTable {
+      public:
+        /// @var `FIRST_SEGMENT_BITS`
+        /// @brief The first segment holds `2^FIRST_SEGMENT_BITS` entries
+        static constexpr size_t FIRST_SEGMENT_BITS = 6;
+
+        /// @var `SEGMENT_COUNT`
+        /// @brief The number of segments in the directory, which is enough for more blocks than any head can ever address
+        static constexpr size_t SEGMENT_COUNT = 40;
+
+        BlockTable() = default;
+        BlockTable(const BlockTable &) = delete;
+        BlockTable &operator=(const BlockTable &) = delete;
+
+        ~BlockTable() {
+            clear();
+            for (auto &segment : segments) {
+                delete[] segment.load(std::memory_order_relaxed);
+            }
+        }
+
+        /// @function `size`
+        /// @brief Returns the number of entries in this table, all entries below this number can be read
+        ///
+        /// @return `size_t` The number of entries
+        inline size_t size() const {
+            return count.load(std::memory_order_acquire);
+        }
+
+        /// @function `operator[]`
+        /// @brief Returns the block with the given id, this is wait-free and safe to call from any thread for any id below `size()`
+        ///
+        /// @param `id` The id of the block
+        /// @return `BlockT *` The block with the given id, nullptr if that block does not exist currently
+        inline BlockT *operator[](const size_t id) const {
+            const size_t segment = get_segment(id);
+            return segments[segment].load(std::memory_order_acquire)[get_offset(id, segment)].load(std::memory_order_acquire);
+        }
+
+        /// @function `load`
+        /// @brief Returns the block with the given id like `operator[]`, but through a sequentially consistent load, which orders it with
+        /// the sequentially consistent accesses around a `release` on another thread
+        ///
+        /// @param `id` The id of the block
+        /// @return `BlockT *` The block with the given id, nullptr if that block does not exist currently
+        inline BlockT *load(const size_t id) const {
+            return get_entry(id).load(std::memory_order_seq_cst);
+        }
+
+        /// @function `resize`
+        /// @brief Grows or shrinks this table to the given number of entries. New entries are empty, the blocks of the entries which are
+        /// cut off are destroyed. The segments are always kept, so readers which are still running never touch freed segment memory
+        ///
+        /// @param `new_count` The new number of entries
+        void resize(const size_t new_count) {
+            const size_t old_count = count.load(std::memory_order_relaxed);
+            for (size_t id = new_count; id < old_count; id++) {
+                reset(id);
+            }
+            for (size_t id = old_count; id < new_count; id++) {
+                const size_t segment = get_segment(id);
+                if (segments[segment].load(std::memory_order_relaxed) == nullptr) {
+                    // The entries are published empty before the segment itself is published
+                    const size_t length = size_t(1) << (segment + FIRST_SEGMENT_BITS);
+                    std::atomic<BlockT *> *entries = new std::atomic<BlockT *>[length];
+                    for (size_t i = 0; i < length; i++) {
+                        entries[i].store(nullptr, std::memory_order_relaxed);
+                    }
+                    segments[segment].store(entries, std::memory_order_release);
+                }
+            }
+            count.store(new_count, std::memory_order_release);
+        }
+
+        /// @function `push_back`
+        /// @brief Appends an empty entry to this table
+        ///
+        /// @return `size_t` The id of the appended entry
+        size_t push_back() {
+            const size_t id = size();
+            resize(id + 1);
+            return id;
+        }
+
+        /// @function `set`
+        /// @brief Puts the given block into the empty entry with the given id, the table owns the block from now on
+        ///
+        /// @param `id` The id of the entry
+        /// @param `block` The block to put into the entry
+        /// @return `BlockT *` The block, which is now owned by the table
+        BlockT *set(const size_t id, std::unique_ptr<BlockT> block) {
+            BlockT *block_ptr = block.release();
+            get_entry(id).store(block_ptr, std::memory_order_release);
+            return block_ptr;
+        }
+
+        /// @function `reset`
+        /// @brief Destroys the block with the given id and empties its entry
+        ///
+        /// @param `id` The id of the entry
+        void reset(const size_t id) {
+            delete get_entry(id).exchange(nullptr, std::memory_order_acq_rel);
+        }
+
+        /// @function `release`
+        /// @brief Empties the entry with the given id without destroying its block, which readers may still be looking at
+        ///
+        /// @param `id` The id of the entry
+        /// @return `std::unique_ptr<BlockT>` The block of the entry, which the caller owns from now on
+        std::unique_ptr<BlockT> release(const size_t id) {
+            return std::unique_ptr<BlockT>(get_entry(id).exchange(nullptr, std::memory_order_seq_cst));
+        }
+
+        /// @function `clear`
+        /// @brief Destroys all blocks and empties this table
+        void clear() {
+            resize(0);
+        }
+
+      private:
+        /// @var `segments`
+        /// @brief The directory of segments, segment `s` holds the entries `[2^(s + B) - 2^B, 2^(s + B + 1) - 2^B)` with `B` being
+        /// `FIRST_SEGMENT_BITS`
+        std::array<std::atomic<std::atomic<BlockT *> *>, SEGMENT_COUNT> segments{};
+
+        /// @var `count`
+        /// @brief The number of entries in this table
+        std::atomic<size_t> count = {0};
+
+        /// @function `get_segment`
+        /// @brief Returns the segment the entry with the given id lives in
+        static inline size_t get_segment(const size_t id) {
+            return 63 - __builtin_clzll(id + (size_t(1) << FIRST_SEGMENT_BITS)) - FIRST_SEGMENT_BITS;
+        }
+
+        /// @function `get_offset`
+        /// @brief Returns the offset of the entry with the given id inside of its segment
+        static inline size_t get_offset(const size_t id, const size_t segment) {
+            return id + (size_t(1) << FIRST_SEGMENT_BITS) - (size_t(1) << (segment + FIRST_SEGMENT_BITS));
+        }
+
+        /// @function `get_entry`
+        /// @brief Returns the entry with the given id
+        inline std::atomic<BlockT *> &get_entry(const size_t id) const {
+            const size_t segment = get_segment(id);
+            return segments[segment].load(std::memory_order_acquire)[get_offset(id, segment)];
+        }
+    };
+} // namespace dima
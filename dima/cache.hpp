@@ -0,0 +1,151 @@
+#pragma once
+
+#include "block.hpp"
+#include "slot.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// @namespace `dima`
+/// @brief The `dima` namespace contains all classes used for the DIMA memory management system
+namespace dima {
+    template <typename T, typename Policy, typename> class Head;
+
+    /// @class `ThreadCache`
+    /// @brief A magazine of reserved, empty slots owned by a single thread for a single head. The owning thread allocates from and releases
+    /// into its cache without any synchronization. Only refilling it goes through the head, and always in batches
+    template <typename T, typename Policy> class ThreadCache {
+      public:
+        /// @struct `Entry`
+        /// @brief A reserved slot together with the block it belongs to
+        struct Entry {
+            Block<T> *block;
+            Slot<T> *slot;
+        };
+
+        /// @var `CAPACITY`
+        /// @brief The maximum number of slots a single thread cache can hold
+        static constexpr uint32_t CAPACITY = Policy::thread_cache_size;
+
+        ThreadCache(Head<T, Policy, void> *head, const uint64_t head_id) :
+            head(head),
+            head_id(head_id) {}
+
+        /// @var `heads_mutex`
+        /// @brief The mutex guarding the `head` of every cache of this type. A head clears the `head` of its caches under it when it is
+        /// destroyed, and a thread which ends holds it from reading the `head` of its caches until it has given their slots back, so a
+        /// head can never be destroyed in between
+        static inline std::mutex heads_mutex;
+
+        /// @var `head`
+        /// @brief The head this cache belongs to, nullptr if the head has been destroyed before the thread owning this cache ended. It may
+        /// only be accessed while `heads_mutex` is held
+        Head<T, Policy, void> *head;
+
+        /// @var `head_id`
+        /// @brief The unique id of the head this cache belongs to. Unlike the head's address, the id is never reused by another head
+        const uint64_t head_id;
+
+        /// @function `pop`
+        /// @brief Takes the most recently cached slot out of this cache
+        ///
+        /// @return `Entry *` The cached slot, nullptr if this cache is empty
+        inline Entry *pop() {
+            const uint32_t size = count.load(std::memory_order_relaxed);
+            if (size == 0) {
+                return nullptr;
+            }
+            count.store(size - 1, std::memory_order_relaxed);
+            return &entries[size - 1];
+        }
+
+        /// @function `push`
+        /// @brief Puts an empty slot into this cache
+        ///
+        /// @param `entry` The empty slot to cache
+        /// @return `bool` Whether the slot was cached, false if this cache is full
+        inline bool push(const Entry &entry) {
+            const uint32_t size = count.load(std::memory_order_relaxed);
+            if (size == CAPACITY) {
+                return false;
+            }
+            entries[size] = entry;
+            count.store(size + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        /// @function `get_size`
+        /// @brief Returns how many slots are currently cached. This may be called from other threads, the result is only a snapshot
+        ///
+        /// @return `uint32_t` The number of cached slots
+        inline uint32_t get_size() const {
+            return count.load(std::memory_order_relaxed);
+        }
+
+      private:
+        /// @var `entries`
+        /// @brief The cached slots, used as a stack so the most recently released slot (which is most likely still in the cache of the
+        /// cpu) is handed out first
+        std::array<Entry, CAPACITY> entries;
+
+        /// @var `count`
+        /// @brief The number of cached slots. It is only ever written by the owning thread, the atomic only exists so other threads can
+        /// read a snapshot of it, no read-modify-write operation is ever done on it
+        std::atomic<uint32_t> count = {0};
+    };
+
+    /// @class `ThreadCacheRegistry`
+    /// @brief All thread caches of a single thread for all heads of the type `T` with the policy `Policy`. When the thread ends, every
+    /// cached slot is given back to its head
+    template <typename T, typename Policy> class ThreadCacheRegistry {
+      public:
+        ThreadCacheRegistry() = default;
+        ThreadCacheRegistry(const ThreadCacheRegistry &) = delete;
+        ThreadCacheRegistry &operator=(const ThreadCacheRegistry &) = delete;
+
+        ~ThreadCacheRegistry() {
+            std::lock_guard<std::mutex> lock(ThreadCache<T, Policy>::heads_mutex);
+            for (auto &cache : caches) {
+                Head<T, Policy, void> *head = cache->head;
+                if (head != nullptr) {
+                    head->drop_thread_cache(*cache);
+                }
+            }
+        }
+
+        /// @function `get`
+        /// @brief Returns the cache of this thread for the given head, creating and registering it on first use
+        ///
+        /// @param `head` The head to get the cache of
+        /// @param `head_id` The unique id of the head
+        /// @return `ThreadCache<T, Policy> &` The cache of this thread for the given head
+        inline ThreadCache<T, Policy> &get(Head<T, Policy, void> *head, const uint64_t head_id) {
+            if (last_cache != nullptr && last_cache->head_id == head_id) {
+                return *last_cache;
+            }
+            for (auto &cache : caches) {
+                if (cache->head_id == head_id) {
+                    last_cache = cache.get();
+                    return *last_cache;
+                }
+            }
+            caches.emplace_back(std::make_unique<ThreadCache<T, Policy>>(head, head_id));
+            last_cache = caches.back().get();
+            head->register_thread_cache(*last_cache);
+            return *last_cache;
+        }
+
+      private:
+        /// @var `caches`
+        /// @brief The caches of this thread, one per head
+        std::vector<std::unique_ptr<ThreadCache<T, Policy>>> caches;
+
+        /// @var `last_cache`
+        /// @brief The most recently used cache, which is almost always the one needed next
+        ThreadCache<T, Policy> *last_cache = nullptr;
+    };
+} // namespace dima
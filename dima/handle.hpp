@@ -0,0 +1,287 @@
+#pragma once
+
+#include "block.hpp"
+#include "head.hpp"
+#include "policy.hpp"
+#include "var.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+
+/// @namespace `dima`
+/// @brief The `dima` namespace contains all classes used for the DIMA memory management system
+namespace dima {
+
+    template <typename T, typename Policy> class Type;
+
+    /// @class `HandleCodec`
+    /// @brief Packs the position of a value into the 32 bits of a handle. The blocks of a head always have the capacities of its growth
+    /// curve, so every slot has a fixed number among all slots of all blocks, counted from the first slot of the first block. A handle
+    /// holds that number plus one, so the handle with all bits cleared is the null handle, and a handle reaches the first `2^32 - 1` slots
+    /// of any sizing policy, no matter how many blocks they are spread over
+    template <typename T> class HandleCodec {
+      public:
+        /// @var `NULL_HANDLE`
+        /// @brief The bits of the handle which refers to nothing
+        static constexpr uint32_t NULL_HANDLE = 0;
+
+        /// @function `encode`
+        /// @brief Returns the handle bits of the value of the given slot, which has to be retained by the caller
+        ///
+        /// @param `slot` The slot of the value
+        /// @return `uint32_t` The handle bits of the value
+        static uint32_t encode(Slot<T> *slot) {
+            // Every slot of a DIMA type lives in one of the blocks of its head
+            const size_t block_id = static_cast<Block<T> *>(slot->get_owner())->get_id();
+            const size_t number = Capacities::get_total_capacity(block_id) + slot->index;
+            if (number >= UINT32_MAX) {
+                throw std::length_error(
+                    "dima: the value lies behind the first 2^32 - 1 slots of its type, which is all a handle can reach");
+            }
+            return static_cast<uint32_t>(number + 1);
+        }
+
+        static inline size_t get_block_id(const uint32_t bits) {
+            // The block of slot number `bits - 1` is the last one of the first `bits` slots
+            return Capacities::get_block_count(bits) - 1;
+        }
+
+        static inline uint32_t get_slot_index(const uint32_t bits, const size_t block_id) {
+            return static_cast<uint32_t>(bits - 1 - Capacities::get_total_capacity(block_id));
+        }
+
+      private:
+        /// @struct `Capacities`
+        /// @brief The capacity table of the type's growth curve, which is the same table its head uses. It is a nested struct instead of
+        /// an alias, so the slot size is only needed once `T` is complete
+        struct Capacities : CapacityTable<typename type_policy<T>::type::sizing, SlotArray<T>::SLOT_SIZE> {};
+    };
+
+    /// @class `Handle`
+    /// @brief An owning reference to a value of a DIMA type in 32 bits, half the size of a `Var`. It holds a reference just like a `Var`,
+    /// but instead of a slot pointer it stores the number of the value's slot (see `HandleCodec`), which is resolved through the capacity
+    /// table and the block table of the type's head on every access. This suits large containers of references, like the edges of a graph,
+    /// where the memory saved outweighs the extra lookup. A handle is not part of the list of variables a slot of a compactable type keeps,
+    /// so it could not follow its value to another slot, which is why compactable types have no handles
+    template <typename T> class Handle {
+      public:
+        static_assert(!Slot<T>::TRACKED, "Handles cannot follow values moved by compaction, use Var or WeakHandle instead");
+        static_assert(std::is_base_of_v<Type<T, typename type_policy<T>::type>, T>,
+            "Handles resolve their values through the head of the DIMA type, so only types deriving from dima::Type can have handles");
+
+        using Codec = HandleCodec<T>;
+
+        Handle() = default;
+
+        Handle(const Var<T> &var) {
+            if (var.slot != nullptr) {
+                // A value of another head of the same type would be looked up in the wrong blocks
+                assert(get_head().owns(var.slot));
+                bits = Codec::encode(var.slot);
+                var.slot->retain();
+            }
+        }
+
+        ~Handle() {
+            if (bits != Codec::NULL_HANDLE) {
+                get_slot()->release();
+            }
+        }
+
+        Handle(const Handle &other) :
+            bits(other.bits) {
+            if (bits != Codec::NULL_HANDLE) {
+                get_slot()->retain();
+            }
+        }
+
+        // Move constructor, which steals the reference of `other` and leaves it null
+        Handle(Handle &&other) noexcept :
+            bits(other.bits) {
+            other.bits = Codec::NULL_HANDLE;
+        }
+
+        Handle &operator=(const Handle &other) {
+            if (this != &other) {
+                if (other.bits != Codec::NULL_HANDLE) {
+                    other.get_slot()->retain();
+                }
+                reset();
+                bits = other.bits;
+            }
+            return *this;
+        }
+
+        // Move assignment, which steals the reference of `other` and leaves it null
+        Handle &operator=(Handle &&other) noexcept {
+            if (this != &other) {
+                reset();
+                bits = other.bits;
+                other.bits = Codec::NULL_HANDLE;
+            }
+            return *this;
+        }
+
+        inline T *operator->() const {
+            return get_slot()->get();
+        }
+
+        inline T &operator*() const {
+            return *get_slot()->get();
+        }
+
+        /// @function `get`
+        /// @brief Returns a raw pointer to the value this handle refers to
+        ///
+        /// @return `T *` The raw pointer to the value
+        inline T *get() const {
+            return get_slot()->get();
+        }
+
+        /// @function `get_var`
+        /// @brief Returns a new variable to the value this handle refers to
+        ///
+        /// @return `Var<T>` The variable to the value, a null variable if this handle is null
+        Var<T> get_var() const {
+            if (bits == Codec::NULL_HANDLE) {
+                return Var<T>(nullptr);
+            }
+            Slot<T> *slot = get_slot();
+            slot->retain();
+            return Var<T>(slot);
+        }
+
+        /// @function `is_null`
+        /// @brief Checks whether this handle refers to nothing
+        ///
+        /// @return `bool` Whether this handle refers to nothing
+        inline bool is_null() const {
+            return bits == Codec::NULL_HANDLE;
+        }
+
+        /// @function `get_bits`
+        /// @brief Returns the raw 32 bits of this handle
+        ///
+        /// @return `uint32_t` The bits of this handle
+        inline uint32_t get_bits() const {
+            return bits;
+        }
+
+      private:
+        template <typename> friend class WeakHandle;
+
+        /// @var `bits`
+        /// @brief The slot number of the value plus one, see `HandleCodec`
+        uint32_t bits = Codec::NULL_HANDLE;
+
+        /// @function `get_head`
+        /// @brief Returns the head all handles of `T` are resolved through, which is the head of the DIMA type `T`
+        ///
+        /// @return `Head<T, typename type_policy<T>::type> &` The head of the type
+        static inline Head<T, typename type_policy<T>::type> &get_head() {
+            return Type<T, typename type_policy<T>::type>::head;
+        }
+
+        /// @function `get_slot`
+        /// @brief Resolves the slot of the value through the block table of the head, the reference of this handle keeps the block alive.
+        /// A null handle has no slot, so this must not be used on it, just like the value of a null `Var` must not be accessed
+        inline Slot<T> *get_slot() const {
+            assert(bits != Codec::NULL_HANDLE);
+            const size_t block_id = Codec::get_block_id(bits);
+            return get_head().resolve(block_id, Codec::get_slot_index(bits, block_id));
+        }
+
+        /// @function `reset`
+        /// @brief Releases the reference of this handle, if it holds one
+        inline void reset() {
+            if (bits != Codec::NULL_HANDLE) {
+                get_slot()->release();
+            }
+        }
+    };
+
+    /// @class `WeakHandle`
+    /// @brief A non-owning reference to a value of a DIMA type, the handle counterpart of `WeakVar`. Next to the 32 handle bits it keeps
+    /// the generation of the value's slot and the low 32 bits of the incarnation of its block, so it takes 12 bytes instead of the 24 bytes
+    /// of a `WeakVar`. It does not keep its value or its block alive, and it can be upgraded to a `Var` as long as the value is still
+    /// alive. A stale weak handle could only upgrade to another value if its slot was reused `2^32` times within one incarnation, or if
+    /// `2^32` incarnations of the type's blocks started in between. Only available for types with `weak_references` enabled in their policy
+    template <typename T> class WeakHandle {
+      public:
+        static_assert(Slot<T>::WEAK, "Only types with weak_references enabled in their policy can have weak handles");
+        static_assert(std::is_base_of_v<Type<T, typename type_policy<T>::type>, T>,
+            "Weak handles upgrade through the head of the DIMA type, so only types deriving from dima::Type can have weak handles");
+
+        using Codec = HandleCodec<T>;
+
+        WeakHandle() = default;
+
+        WeakHandle(const Var<T> &var) {
+            if (var.slot != nullptr) {
+                remember(var.slot);
+            }
+        }
+
+        WeakHandle(const Handle<T> &handle) {
+            if (!handle.is_null()) {
+                remember(handle.get_slot());
+            }
+        }
+
+        /// @function `upgrade`
+        /// @brief Returns a new variable to the value this weak handle refers to, if that value is still alive
+        ///
+        /// @return `std::optional<Var<T>>` A variable to the value, nullopt if the value is gone
+        std::optional<Var<T>> upgrade() const {
+            if (bits == Codec::NULL_HANDLE) {
+                return std::nullopt;
+            }
+            const size_t block_id = Codec::get_block_id(bits);
+            return Handle<T>::get_head().upgrade_handle(block_id, incarnation, Codec::get_slot_index(bits, block_id), generation);
+        }
+
+        /// @function `is_null`
+        /// @brief Checks whether this weak handle was never given a value to refer to
+        ///
+        /// @return `bool` Whether this weak handle refers to nothing
+        inline bool is_null() const {
+            return bits == Codec::NULL_HANDLE;
+        }
+
+        /// @function `get_bits`
+        /// @brief Returns the raw 32 handle bits of this weak handle
+        ///
+        /// @return `uint32_t` The handle bits of this weak handle
+        inline uint32_t get_bits() const {
+            return bits;
+        }
+
+      private:
+        /// @var `bits`
+        /// @brief The slot number of the value plus one, see `HandleCodec`
+        uint32_t bits = Codec::NULL_HANDLE;
+
+        /// @var `generation`
+        /// @brief The generation of the slot the value was allocated in, see `SlotGeneration`
+        uint32_t generation = 0;
+
+        /// @var `incarnation`
+        /// @brief The low 32 bits of the incarnation of the block the value was allocated in, see `Block::incarnation`
+        uint32_t incarnation = 0;
+
+        /// @function `remember`
+        /// @brief Remembers where the value of the given slot lives, the slot has to be retained by the caller
+        ///
+        /// @param `slot` The slot of the value
+        void remember(Slot<T> *slot) {
+            assert(Handle<T>::get_head().owns(slot));
+            bits = Codec::encode(slot);
+            generation = slot->get_generation();
+            // Every slot of a DIMA type lives in one of the blocks of its head
+            incarnation = static_cast<uint32_t>(static_cast<Block<T> *>(slot->get_owner())->get_incarnation());
+        }
+    };
+} // namespace dima
@@ -1,10 +1,20 @@
 #pragma once
 
 #include "block.hpp"
+#include "block_table.hpp"
+#include "cache.hpp"
+#include "policy.hpp"
 #include "var.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -12,29 +22,27 @@
 /// @namespace `dima`
 /// @brief The `dima` namespace contains all classes used for the DIMA memory management system
 namespace dima {
-    static constexpr size_t BASE_CAPACITY = 16;
-    static constexpr size_t GROWTH_FACTOR = 11;
-
     /// @function `get_block_capacity`
-    /// @brief Calculates the block capacity of the given index of the block
+    /// @brief Returns the block capacity of the given index of the block for the default sizing policy
     /// This function mirrors the C library's dima_get_block_capacity function
     ///
     /// @param `index` The index of the block to get the capacity from
     /// @return `size_t` The capacity of the block at the given index
     inline size_t get_block_capacity(const size_t index) {
-        size_t cap = BASE_CAPACITY;
-        for (size_t j = 0; j < index; j++) {
-            // Integer mul/div with ceil rounding to approximate float growth
-            // This approximates a 1.1x growth factor (GROWTH_FACTOR = 11 means 11/10 = 1.1)
-            cap = (cap * GROWTH_FACTOR + 9) / 10;
-        }
-        return cap;
+        // The default growth curve does not depend on the slot size
+        return CapacityTable<default_policy::sizing, 1>::get_capacity(index);
     }
 
     /// @class `Head`
     /// @brief The head structure managing all allocated blocks, with incremental growth
-    template <typename T, typename = std::enable_if_t<std::is_class_v<T>>> //
-    class Head {
+    template <typename T, typename Policy = default_policy, typename = std::enable_if_t<std::is_class_v<T>>> //
+    class Head final : private BlockOwner<T> {
+      private:
+        /// @struct `Capacities`
+        /// @brief The compile-time capacity table of this head's growth curve. It is a nested struct instead of an alias, so the slot size
+        /// is only needed once `T` is complete
+        struct Capacities : CapacityTable<typename Policy::sizing, SlotArray<T>::SLOT_SIZE> {};
+
       public:
         /// @function `allocate`
         /// @brief Creates a new variable of type `T` and saves it in one of the blocks
@@ -42,38 +50,147 @@ namespace dima {
         /// @param `args` The arguments with which to create the type T slot
         /// @return `Var<T>` A variable node to the allocated object of type `T`
         template <typename... Args> Var<T> allocate(Args &&...args) {
-            // Try to allocate in an existing block
-            for (size_t i = blocks.size(); i > 0; i--) {
-                auto *block_ptr = blocks[i - 1].get();
-                if (block_ptr == nullptr) {
-                    continue;
+            if constexpr (Slot<T>::BIASED) {
+                // References released on other threads are dropped by the allocating thread whenever it comes back to allocate
+                if (BiasedThreads::has_deferred()) {
+                    BiasedThreads::collect();
+                }
+            }
+            if constexpr (CACHED) {
+                // Allocate from this thread's cache, which only needs to be refilled from the blocks once every few allocations
+                ThreadCache<T, Policy> &cache = get_thread_cache();
+                typename ThreadCache<T, Policy>::Entry *popped = cache.pop();
+                if (popped == nullptr) {
+                    refill_thread_cache(cache);
+                    popped = cache.pop();
+                }
+                // The entry is copied out of the cache, as a constructor releasing a value of this type pushes its slot into the same place
+                const typename ThreadCache<T, Policy>::Entry entry = *popped;
+                try {
+                    entry.slot->allocate(std::forward<Args>(args)...);
+                } catch (...) {
+                    // The slot is still empty after a throwing constructor, so it goes right back into the cache it was just taken from
+                    cache.push(entry);
+                    throw;
+                }
+                return Var<T>(entry.slot);
+            } else if constexpr (CONCURRENT) {
+                // Every thread claims its slot in the shared allocation block directly, the blocks mutex is only taken to switch blocks
+                Slot<T> *slot = reserve_concurrent();
+                try {
+                    slot->allocate(std::forward<Args>(args)...);
+                } catch (...) {
+                    // The slot is still empty after a throwing constructor, so it is given right back to its block
+                    static_cast<Block<T> *>(slot->get_owner())->free_slot(slot);
+                    throw;
+                }
+                return Var<T>(slot);
+            } else {
+                // Try to allocate in the largest existing block which still has free slots
+                size_t block_id = non_full_blocks.find_last();
+                if (block_id == BlockSet::NONE) {
+                    // Apply the block mutex, as now definitely a new block will be added one way or the other. The value is constructed
+                    // after the lock is released again, as a throwing constructor hands its slot back, which can empty the new block
+                    std::lock_guard<Mutex> lock(blocks_mutex);
+                    advance_epoch();
+                    block_id = create_free_block();
+                }
+                return allocate_in_block(block_id, std::forward<Args>(args)...);
+            }
+        }
+
+        /// @function `allocate_bulk`
+        /// @brief Creates `n` independent values of type `T` at once and writes a variable to every one of them into `out`. The slots are
+        /// reserved from the blocks in batches of up to one occupancy bitmap word, so the blocks are searched (and with thread caches the
+        /// lock is taken) once per batch instead of once per value. The values are not placed contiguously, unlike an array
+        ///
+        /// @param `n` The number of values to create
+        /// @param `out` The output iterator every `Var<T>` is written to, in the order of the values
+        /// @param `generate` The function called with the index of every value, whose result the value is created from. A generator
+        /// returning a `T` constructs it directly in its slot. If it throws, the values created before are kept in `out`, all slots which
+        /// did not receive a value are handed back and the exception is passed on
+        /// @return `OutputIt` The output iterator behind the last written variable
+        template <typename OutputIt, typename Generator> OutputIt allocate_bulk(const size_t n, OutputIt out, Generator &&generate) {
+            if constexpr (Slot<T>::BIASED) {
+                if (BiasedThreads::has_deferred()) {
+                    BiasedThreads::collect();
+                }
+            }
+            std::array<Slot<T> *, BULK_BATCH_SIZE> batch;
+            for (size_t done = 0; done < n;) {
+                const uint32_t wanted = static_cast<uint32_t>(std::min(n - done, BULK_BATCH_SIZE));
+                uint32_t count;
+                if constexpr (CACHED) {
+                    // The thread caches are bypassed, the batch is reserved from the blocks directly
+                    std::lock_guard<Mutex> lock(blocks_mutex);
+                    count = reserve_batch(batch.data(), wanted);
+                } else {
+                    count = reserve_batch(batch.data(), wanted);
                 }
-                if (block_ptr->get_free_count() > 0) {
-                    auto var = block_ptr->allocate(std::forward<Args>(args)...);
-                    if (var.has_value()) {
-                        return var.value();
+                uint32_t next = 0;
+                try {
+                    while (next < count) {
+                        Slot<T> *slot = batch[next];
+                        slot->allocate_from([&generate, idx = done + next]() -> decltype(auto) { return generate(idx); });
+                        // From here on the variable owns the value, even if writing it to the output throws
+                        next++;
+                        *out = Var<T>(slot);
+                        ++out;
                     }
+                } catch (...) {
+                    // The slots which did not receive a value are still empty, so they are handed back just like released ones, while the
+                    // variables written so far stay valid
+                    free_batch(batch.data() + next, count - next);
+                    throw;
                 }
+                done += count;
             }
-            // Apply the block mutex, as now definitely a new block will be added one way or the other
-            std::lock_guard<std::mutex> lock(blocks_mutex);
+            return out;
+        }
 
-            // Try to cerate a block that isnt created yet in the current blocks vector
-            for (size_t i = blocks.size(); i > 0; i--) {
-                if (blocks[i - 1] != nullptr) {
+        /// @function `allocate_n`
+        /// @brief Creates `n` independent values of type `T` at once, all constructed from the same arguments, see `allocate_bulk`
+        ///
+        /// @param `n` The number of values to create
+        /// @param `out` The output iterator every `Var<T>` is written to
+        /// @param `args` The arguments with which every value is created, they are passed to every constructor as lvalues
+        /// @return `OutputIt` The output iterator behind the last written variable
+        template <typename OutputIt, typename... Args> OutputIt allocate_n(const size_t n, OutputIt out, const Args &...args) {
+            return allocate_bulk(n, out, [&args...](size_t) { return T(args...); });
+        }
+
+        /// @function `release_bulk`
+        /// @brief Releases the references of all variables in the range `[first, last)` at once and leaves the variables null. The values
+        /// whose last reference was released are destroyed right away, but their slots are collected and handed back to their blocks in
+        /// groups of neighbouring slots of the same block, so every block clears its occupancy bits word by word and updates its counters
+        /// and the indices of this head once per group instead of once per slot. Ranges whose values were allocated together, like the
+        /// ones filled by `allocate_bulk`, form the largest groups
+        ///
+        /// @param `first` The iterator to the first variable
+        /// @param `last` The iterator behind the last variable
+        template <typename Iterator> void release_bulk(Iterator first, Iterator last) {
+            std::array<Slot<T> *, RELEASE_BATCH_SIZE> batch;
+            uint32_t count = 0;
+            for (; first != last; ++first) {
+                Var<T> &var = *first;
+                if (var.slot == nullptr) {
+                    continue;
+                }
+                Slot<T> *slot = var.slot;
+                var.unlink();
+                var.slot = nullptr;
+                if (!slot->drop()) {
                     continue;
                 }
-                blocks[i - 1] = std::make_unique<Block<T>>(i - 1, get_block_capacity(i - 1));
-                blocks[i - 1]->set_empty_callback([this](Block<T> *empty_block) { this->block_emptied(empty_block); });
-                return blocks[i - 1]->allocate(std::forward<Args>(args)...).value();
+                batch[count++] = slot;
+                if (count == RELEASE_BATCH_SIZE) {
+                    free_batch(batch.data(), count);
+                    count = 0;
+                }
+            }
+            if (count > 0) {
+                free_batch(batch.data(), count);
             }
-
-            // If all blocks are full, create a new block with the calculated size, a new block definitely has space for a new variable
-            const size_t block_id = blocks.size();
-            blocks.emplace_back(std::make_unique<Block<T>>(block_id, get_block_capacity(block_id)));
-            blocks.back()->set_empty_callback([this](Block<T> *empty_block) { this->block_emptied(empty_block); });
-            // The now allocated slot should **always** have a value
-            return blocks.back()->allocate(std::forward<Args>(args)...).value();
         }
 
         /// @function `allocate_array`
@@ -84,114 +201,807 @@ namespace dima {
         /// @param `args` The arguments with which every slot in the array will be initialized
         /// @return `Array<T>` The array node which provides a lot of QOL features for handling the array
         template <typename... Args> Array<T> allocate_array(const size_t length, Args &&...args) {
-            // Try to allocate in an existing block
-            for (size_t i = blocks.size(); i > 0; i--) {
-                auto *block_ptr = blocks[i - 1].get();
-                if (block_ptr == nullptr) {
-                    continue;
-                }
-                if (block_ptr->get_free_count() >= length) {
+            static_assert(!CONCURRENT, "Arrays need a contiguous run of free slots, which concurrent blocks cannot claim at once");
+            // Note: allocate_array requires length + 2 slots for padding on both ends
+            const size_t required_capacity = length + 2;
+
+            // With thread caches, other threads modify the blocks concurrently, so even searching the existing blocks needs the lock
+            std::unique_lock<Mutex> lock(blocks_mutex, std::defer_lock);
+            if constexpr (CACHED) {
+                lock.lock();
+            }
+
+            // Try to allocate in an existing block, only visiting blocks whose largest free run can fit the array
+            for (size_t run_class = RUN_CLASS_COUNT; run_class > get_run_class(required_capacity); run_class--) {
+                const BlockSet &candidates = free_run_blocks[run_class - 1];
+                for (size_t i = candidates.find_last(); i != BlockSet::NONE; i = candidates.find_last(i)) {
+                    Block<T> *block_ptr = blocks[i];
+                    if (block_ptr->get_largest_free_run_hint() < required_capacity) {
+                        continue;
+                    }
                     auto arr = block_ptr->allocate_array(length, std::forward<Args>(args)...);
+                    index_block(i);
                     if (arr.has_value()) {
+                        reuse_block(i);
                         return arr.value();
                     }
                 }
             }
             // Apply the block mutex, as now definitely a new block will be added one way or the other
-            std::lock_guard<std::mutex> lock(blocks_mutex);
+            if (!lock.owns_lock()) {
+                lock.lock();
+            }
+            advance_epoch();
 
-            // Calculate how many blocks we need to ensure we have one large enough
-            // Note: allocate_array requires length + 2 slots for padding on both ends
-            size_t required_capacity = length + 2;
-            size_t required_block_index = blocks.size();
-            while (get_block_capacity(required_block_index) < required_capacity) {
-                required_block_index++;
+            // Find the first block (from the end of the blocks vector) which is large enough to hold the array
+            const size_t required_block_index = Capacities::get_first_fitting_block(blocks.size(), required_capacity);
+            if (required_block_index == SIZE_MAX) {
+                throw std::length_error("dima: the array does not fit into any block of this type's sizing policy");
             }
 
-            // Expand blocks vector to have enough slots for the required block
-            while (blocks.size() <= required_block_index) {
-                blocks.push_back(nullptr);
+            // Expand the block table to have enough entries for the required block
+            if (blocks.size() <= required_block_index) {
+                blocks.resize(required_block_index + 1);
             }
 
-            // Try to create a block that isn't created yet in the current blocks vector
+            // Create the largest block which isn't created yet in the current block table and can fit the array. If there is none, which
+            // should never happen, use the calculated required index as safety
+            size_t block_id = required_block_index;
             for (size_t i = blocks.size(); i > 0; i--) {
-                if (blocks[i - 1] != nullptr) {
-                    continue;
-                }
-                const size_t block_capacity = get_block_capacity(i - 1);
-                if (block_capacity >= length) {
-                    // This block can fit the array, create it and allocate
-                    blocks[i - 1] = std::make_unique<Block<T>>(i - 1, block_capacity);
-                    blocks[i - 1]->set_empty_callback([this](Block<T> *empty_block) { this->block_emptied(empty_block); });
-                    auto arr = blocks[i - 1]->allocate_array(length, std::forward<Args>(args)...);
-                    if (arr.has_value()) {
-                        return arr.value();
-                    }
+                if (blocks[i - 1] == nullptr && Capacities::get_capacity(i - 1) >= required_capacity) {
+                    block_id = i - 1;
+                    break;
                 }
             }
-
-            // This should never be reached, but as safety, use the calculated required index
-            const size_t block_id = required_block_index;
             if (blocks[block_id] == nullptr) {
-                blocks[block_id] = std::make_unique<Block<T>>(block_id, get_block_capacity(block_id));
-                blocks[block_id]->set_empty_callback([this](Block<T> *empty_block) { this->block_emptied(empty_block); });
+                create_block(block_id);
+            }
+            if constexpr (!CACHED) {
+                // The elements are constructed after the lock is released again, as a throwing constructor hands the slots back, which
+                // empties the new block
+                lock.unlock();
             }
-            return blocks[block_id]->allocate_array(length, std::forward<Args>(args)...).value();
+            auto arr = blocks[block_id]->allocate_array(length, std::forward<Args>(args)...);
+            index_block(block_id);
+            return arr.value();
         }
 
         /// @function `reserve`
         /// @brief Reserves enough space in the DIMA tree that at least `n` objects will fit in it. This function only creates the biggest
-        /// block in the block list, which holds at least `(n / 2) + BASE_SIZE` elements, as block creation and block filling is done from
+        /// block of the block list which the growth curve needs to hold `n` elements, as block creation and block filling is done from
         /// the biggest to the smallest blocks. This reduces fragmentation over time and also improves allocation speed, as the biggest
         /// blocks are the most unlikely to be filled up.
         ///
         /// @param `n` The number of objects to reserve
         void reserve(const size_t n) {
-            std::lock_guard<std::mutex> lock(blocks_mutex);
-            // Calculate how many blocks we need to reserve capacity for n items
-            size_t total_capacity = 0;
-            size_t block_index = 0;
-            while (total_capacity < n) {
-                total_capacity += get_block_capacity(block_index);
-                block_index++;
+            if (n == 0) {
+                return;
             }
+            std::lock_guard<Mutex> lock(blocks_mutex);
+            // Calculate how many blocks we need to reserve capacity for n items, directly from the capacity table
+            const size_t block_index = Capacities::get_block_count(n);
 
-            // Ensure we have enough blocks in the vector
-            while (blocks.size() < block_index) {
-                blocks.push_back(nullptr);
+            // Ensure we have enough entries in the block table
+            if (blocks.size() < block_index) {
+                blocks.resize(block_index);
             }
 
             // Create the final block if it doesn't exist
             if (blocks[block_index - 1] == nullptr) {
-                blocks[block_index - 1] = std::make_unique<Block<T>>(block_index - 1, get_block_capacity(block_index - 1));
-                blocks[block_index - 1]->set_empty_callback([this](Block<T> *empty_block) { this->block_emptied(empty_block); });
+                create_block(block_index - 1);
+            }
+        }
+
+        /// @function `trim`
+        /// @brief Destroys all empty blocks which are kept alive by the retention policy of this head. With concurrent blocks, which are
+        /// never destroyed when they become empty, it destroys all empty blocks instead, and no other thread may allocate or release values
+        /// of this head while it runs
+        ///
+        /// @return `size_t` The number of destroyed blocks
+        size_t trim() {
+            std::lock_guard<Mutex> lock(blocks_mutex);
+            size_t count = 0;
+            if constexpr (CONCURRENT) {
+                // Removing a block can truncate the table below the next id
+                for (size_t id = blocks.size(); id > 0; id = std::min(id - 1, blocks.size())) {
+                    Block<T> *block_ptr = blocks[id - 1];
+                    if (block_ptr != nullptr && block_ptr->get_allocation_count() == 0) {
+                        remove_block(block_ptr);
+                        count++;
+                    }
+                }
+                return count;
+            }
+            for (size_t id = retained_blocks.find_last(); id != BlockSet::NONE; id = retained_blocks.find_last(id)) {
+                release_retained_block(id);
+                count++;
+            }
+            return count;
+        }
+
+        /// @function `compact`
+        /// @brief Moves live values out of sparsely occupied blocks into denser ones until the given time budget is used up. Every value is
+        /// moved through the move constructor of `T`, and all variables referring to it are redirected to its new slot. Emptied blocks
+        /// are given back through the retention policy. Every call continues where the last one stopped, so compaction can be spread
+        /// across many short steps, for example from an idle loop. Pinned values and arrays are never moved, and blocks holding pinned
+        /// values are never emptied. Must be called from the thread which allocates the values of this head
+        ///
+        /// @param `budget` The time this step may take at most
+        /// @return `size_t` The number of moved values
+        size_t compact(const std::chrono::microseconds budget) {
+            static_assert(Compaction::enabled && Slot<T>::TRACKED, "Only types with an incremental_compaction policy can be compacted");
+            static_assert(!CACHED, "Compaction cannot be combined with thread caches");
+            static_assert(!CONCURRENT, "Compaction cannot be combined with concurrent blocks");
+            const auto deadline = std::chrono::steady_clock::now() + budget;
+            size_t moved = 0;
+            Block<T> *source = nullptr;
+            Block<T> *target = nullptr;
+            uint32_t next_slot = 0;
+            while (true) {
+                if (source == nullptr) {
+                    source = find_compaction_source();
+                    if (source == nullptr) {
+                        // Every sparse block has been visited, the next step starts over from the first block
+                        compact_cursor = 0;
+                        break;
+                    }
+                    target = nullptr;
+                    next_slot = 0;
+                }
+                if (target == nullptr || target->get_free_count() == 0) {
+                    target = find_compaction_target(source);
+                    if (target == nullptr) {
+                        // No block is at least as dense as this one, so it is the densest of all sparse blocks and is left as it is
+                        compact_cursor = source->get_id() + 1;
+                        source = nullptr;
+                        continue;
+                    }
+                }
+                const std::optional<uint32_t> idx = source->find_occupied_slot(next_slot);
+                if (!idx.has_value()) {
+                    // Only arrays are left in this block
+                    compact_cursor = source->get_id() + 1;
+                    source = nullptr;
+                    continue;
+                }
+                next_slot = idx.value() + 1;
+                Slot<T> *slot = source->get_slot(idx.value());
+                // Values waiting for deferred reclamation are already unused and only wait to be destroyed
+                if (!slot->is_occupied() || slot->is_array_start() || slot->is_array_member()) {
+                    continue;
+                }
+                {
+                    // Upgrades of compactable types hold the blocks mutex, so they never see a value halfway through its move
+                    std::lock_guard<Mutex> lock(blocks_mutex);
+                    slot->relocate(target->reserve_slot());
+                    index_block(target->get_id());
+                }
+                // The lock is released before the source slot is handed back, as an emptied block takes it itself. The source slot is
+                // unused already, so no upgrade accepts it anymore. Freeing the last slot of the source destroys it or hands it to the retention policy
+                const bool emptied = source->get_allocation_count() == 1;
+                source->free_slot(slot);
+                if (emptied) {
+                    source = nullptr;
+                }
+                moved++;
+                if (moved % COMPACT_CHECK_INTERVAL == 0 && std::chrono::steady_clock::now() >= deadline) {
+                    break;
+                }
+            }
+            return moved;
+        }
+
+        /// @function `upgrade`
+        /// @brief Returns a new variable to the value a weak variable refers to, if that value is still alive, see `WeakVar`. For thread
+        /// safe types the block, its incarnation and the slot generation are checked optimistically without any lock, and the slot is only
+        /// retained if it still holds a value. Once the reference is held the block cannot become empty anymore, so checking the
+        /// incarnation and the generation again tells whether the retained value is the one the weak variable refers to. Blocks removed
+        /// meanwhile are only destroyed once no upgrade looks at them anymore, see `retire_block`. Compactable types hold the blocks mutex
+        /// instead, as their values move between slots under it
+        ///
+        /// @param `block_id` The id of the block of the value
+        /// @param `incarnation` The incarnation of the block the value was allocated in
+        /// @param `slot_index` The index of the slot of the value inside of its block
+        /// @param `generation` The generation of the slot the value was allocated in
+        /// @return `std::optional<Var<T>>` A variable to the value, nullopt if the value is gone
+        std::optional<Var<T>> upgrade(const size_t block_id, const uint64_t incarnation, const uint32_t slot_index,
+            const uint32_t generation) {
+            return upgrade_slot(block_id, slot_index, generation, [incarnation](const Block<T> *block) {
+                return block->get_incarnation() == incarnation;
+            });
+        }
+
+        /// @function `upgrade_handle`
+        /// @brief Returns a new variable to the value a weak handle refers to, if that value is still alive, see `WeakHandle`. It works
+        /// like `upgrade`, but a weak handle only keeps the low 32 bits of the incarnation of the value's block
+        ///
+        /// @param `block_id` The id of the block of the value
+        /// @param `incarnation` The low 32 bits of the incarnation of the block the value was allocated in
+        /// @param `slot_index` The index of the slot of the value inside of its block
+        /// @param `generation` The generation of the slot the value was allocated in
+        /// @return `std::optional<Var<T>>` A variable to the value, nullopt if the value is gone
+        std::optional<Var<T>> upgrade_handle(const size_t block_id, const uint32_t incarnation, const uint32_t slot_index,
+            const uint32_t generation) {
+            return upgrade_slot(block_id, slot_index, generation, [incarnation](const Block<T> *block) {
+                return static_cast<uint32_t>(block->get_incarnation()) == incarnation;
+            });
+        }
+
+        /// @function `resolve`
+        /// @brief Returns the slot at the given index of the block with the given id, which is how a `Handle` finds its value. This is
+        /// wait-free, but the block has to be kept alive by the caller, for example through a reference to the slot
+        ///
+        /// @param `block_id` The id of the block
+        /// @param `slot_index` The index of the slot inside of the block
+        /// @return `Slot<T> *` The slot
+        inline Slot<T> *resolve(const size_t block_id, const uint32_t slot_index) const {
+            return blocks[block_id]->get_slot(slot_index);
+        }
+
+        /// @function `owns`
+        /// @brief Checks whether the given slot lives in one of the blocks of this head. The slot has to be retained by the caller, which
+        /// keeps its block alive
+        ///
+        /// @param `slot` The slot to check
+        /// @return `bool` Whether the slot belongs to this head
+        bool owns(Slot<T> *slot) const {
+            // Every slot lives in a block of some head, so its owner always is a block
+            Block<T> *block = static_cast<Block<T> *>(slot->get_owner());
+            const size_t block_id = block->get_id();
+            return block_id < blocks.size() && blocks[block_id] == block;
+        }
+
+        ~Head() {
+            if constexpr (CACHED) {
+                // Threads which outlive this head must not give their cached slots back to it. The heads mutex is taken first, as a
+                // thread ending right now holds it while it gives its cached slots back to this head
+                std::lock_guard<std::mutex> heads_lock(ThreadCache<T, Policy>::heads_mutex);
+                std::lock_guard<Mutex> lock(blocks_mutex);
+                for (ThreadCache<T, Policy> *cache : thread_caches) {
+                    cache->head = nullptr;
+                }
             }
         }
 
       private:
+        /// @var `CACHED`
+        /// @brief Whether every thread allocates from its own thread cache, see `default_policy::thread_cache_size`
+        static constexpr bool CACHED = Policy::thread_cache_size > 0;
+
+        /// @struct `NoMutex`
+        /// @brief The placeholder for the blocks mutex of single threaded heads, locking it does nothing
+        struct NoMutex {
+            void lock() {}
+            void unlock() {}
+            bool try_lock() {
+                return true;
+            }
+        };
+
+        /// @var `Mutex`
+        /// @brief The type of the blocks mutex, which is only a real mutex if the values of this head may be shared between threads
+        using Mutex = std::conditional_t<Policy::thread_safe, std::mutex, NoMutex>;
+
+        static_assert(Policy::thread_safe || !CACHED, "Thread caches are only needed by thread safe types");
+
+        /// @var `CONCURRENT`
+        /// @brief Whether every thread claims its slots in shared blocks without a lock, see `default_policy::concurrent_blocks`
+        static constexpr bool CONCURRENT = Policy::concurrent_blocks;
+
+        static_assert(Policy::thread_safe || !CONCURRENT, "Concurrent blocks are only needed by thread safe types");
+        static_assert(!CONCURRENT || !CACHED, "Concurrent blocks and thread caches are two ways of sharing blocks, only one can be used");
+
+        /// @var `RUN_CLASS_COUNT`
+        /// @brief The number of free run classes, a block with a largest free run of `r` slots is in the class `floor(log2(r))`
+        static constexpr size_t RUN_CLASS_COUNT = 32;
+
+        /// @var `NO_RUN_CLASS`
+        /// @brief The run class of blocks which are not part of any free run class
+        static constexpr uint8_t NO_RUN_CLASS = UINT8_MAX;
+
+        /// @var `REFILL_COUNT`
+        /// @brief The number of empty slots a thread cache is refilled with from the blocks at once. Only filling half of a cache leaves
+        /// room for the slots the thread releases again, so a thread alternating between allocating and releasing stays within its cache
+        static constexpr uint32_t REFILL_COUNT = Policy::thread_cache_size / 2 > 0 ? Policy::thread_cache_size / 2 : 1;
+
+        /// @var `Retention`
+        /// @brief The retention policy of this head, see `keep_empty_blocks`
+        using Retention = typename Policy::retention;
+
+        /// @var `Compaction`
+        /// @brief The compaction policy of this head, see `incremental_compaction`
+        using Compaction = typename Policy::compaction;
+
+        static_assert(!CONCURRENT || Retention::max_blocks == 0,
+            "Concurrent blocks are kept until trim once they become empty, so they take no retention policy");
+        static_assert(!CONCURRENT || !Policy::weak_references,
+            "Concurrent blocks construct their slots anew on every claim, so they keep no generations for weak references");
+
+        /// @var `BULK_BATCH_SIZE`
+        /// @brief The number of slots `allocate_bulk` reserves at once at most, which is a single word of the occupancy bitmap
+        static constexpr size_t BULK_BATCH_SIZE = 64;
+
+        /// @var `RELEASE_BATCH_SIZE`
+        /// @brief The number of freed slots `release_bulk` collects before it hands them back to their blocks
+        static constexpr uint32_t RELEASE_BATCH_SIZE = 256;
+
+        /// @var `COMPACT_CHECK_INTERVAL`
+        /// @brief The number of values `compact` moves between two looks at the clock
+        static constexpr size_t COMPACT_CHECK_INTERVAL = 8;
+
+        /// @var `RANGED`
+        /// @brief Whether all blocks of this head live in a single reserved address range, see `reserved_range_memory`
+        static constexpr bool RANGED = is_reserved_range<typename Policy::memory>::value;
+
+        /// @var `OPTIMISTIC_UPGRADES`
+        /// @brief Whether weak references are upgraded without the blocks mutex, see `upgrade`. Compactable types always take the mutex,
+        /// as compaction moves values between slots while it holds it, and single threaded types have no mutex to avoid
+        static constexpr bool OPTIMISTIC_UPGRADES = Policy::thread_safe && Slot<T>::WEAK && !Slot<T>::TRACKED;
+
+        /// @struct `NoRange`
+        /// @brief The placeholder for the address range of heads which do not reserve one
+        struct NoRange {};
+
+        /// @var `range`
+        /// @brief The reserved address range of this head, if its memory provider reserves one. It is declared before the blocks, so it is
+        /// only released after all blocks inside of it have been destroyed
+        std::conditional_t<RANGED, typename Policy::memory, NoRange> range;
+
+        /// @var `range_offsets`
+        /// @brief The offset of every block id inside of the reserved address range. Every block id owns a fixed, page aligned part of the
+        /// range, so the blocks lie in the range in the order of their ids. Only used if this head reserves a range
+        std::vector<size_t> range_offsets;
+
         /// @var `blocks`
-        /// @brief A list of all currently active blocks
-        std::vector<std::unique_ptr<Block<T>>> blocks;
+        /// @brief The table of all currently active blocks, which can be read without the blocks mutex from any thread at any time
+        BlockTable<Block<T>> blocks;
+
+        /// @var `retired_blocks`
+        /// @brief The blocks removed in the current upgrade epoch, which an upgrade not holding the blocks mutex may still be looking at,
+        /// see `retire_block`
+        std::vector<std::unique_ptr<Block<T>>> retired_blocks;
+
+        /// @var `expiring_blocks`
+        /// @brief The blocks removed before the last upgrade epoch started, which are destroyed once the upgrades of the epochs before it
+        /// have finished
+        std::vector<std::unique_ptr<Block<T>>> expiring_blocks;
+
+        /// @var `upgrade_epoch`
+        /// @brief The current upgrade epoch, which only advances while the blocks mutex is held, see `retire_block`
+        std::atomic<size_t> upgrade_epoch = {0};
+
+        /// @var `active_upgrades`
+        /// @brief The number of running upgrades which do not hold the blocks mutex, split by the parity of the epoch they started in, see
+        /// `upgrade`
+        std::array<std::atomic<size_t>, 2> active_upgrades{};
+
+        /// @var `allocation_block`
+        /// @brief The id of the block all threads claim their slots in with concurrent blocks. It is only switched to another block under
+        /// the blocks mutex once it ran full, or to a block which gained free slots while it is full, see `offer_block`. It lives on its
+        /// own cache line, as every concurrent allocation reads it
+        alignas(64) std::atomic<size_t> allocation_block = {0};
+
+        /// @var `non_full_blocks`
+        /// @brief The set of all blocks which have at least one free slot, this lets `allocate` find a block with free space without
+        /// visiting any full block
+        BlockSet non_full_blocks;
+
+        /// @var `free_run_blocks`
+        /// @brief The blocks grouped by the class of their largest free run hint, this lets `allocate_array` only visit blocks which can
+        /// potentially fit the array
+        std::array<BlockSet, RUN_CLASS_COUNT> free_run_blocks;
+
+        /// @var `block_run_classes`
+        /// @brief The free run class every block is currently indexed in, `NO_RUN_CLASS` for blocks which are not indexed
+        std::vector<uint8_t> block_run_classes;
+
+        /// @var `retained_blocks`
+        /// @brief The set of all empty blocks which are kept alive by the retention policy
+        BlockSet retained_blocks;
+
+        /// @var `retained_since`
+        /// @brief The epoch every retained block became empty in
+        std::vector<size_t> retained_since;
+
+        /// @var `retained_count`
+        /// @brief The number of retained blocks
+        size_t retained_count = 0;
+
+        /// @var `retained_bytes`
+        /// @brief The number of slot bytes of all retained blocks
+        size_t retained_bytes = 0;
+
+        /// @var `epoch`
+        /// @brief The current allocation epoch, see `advance_epoch`
+        size_t epoch = 0;
+
+        /// @var `compact_cursor`
+        /// @brief The id of the first block the next compaction step looks at for sparse blocks
+        size_t compact_cursor = 0;
 
         /// @var `blocks_mutex`
         /// @brief A mutex to ensure only one thread can modify the blocks at a time
-        std::mutex blocks_mutex;
+        Mutex blocks_mutex;
+
+        /// @var `head_counter`
+        /// @brief The number of heads of this type ever created, used to give every head a unique id
+        static inline std::atomic<uint64_t> head_counter = {0};
+
+        /// @var `head_id`
+        /// @brief The unique id of this head, which identifies the thread caches of this head
+        const uint64_t head_id = head_counter++;
+
+        /// @var `thread_caches`
+        /// @brief The thread caches of all threads which allocated or released slots of this head and are still running
+        std::vector<ThreadCache<T, Policy> *> thread_caches;
+
+        /// @var `remote_blocks`
+        /// @brief A lock-free stack of all blocks which have a non-empty remote free list, linked through `Block::next_remote_block`
+        std::atomic<Block<T> *> remote_blocks = {nullptr};
+
+        /// @var `remote_free_count`
+        /// @brief The number of slots on all remote free lists
+        std::atomic<size_t> remote_free_count = {0};
+
+        friend class ThreadCacheRegistry<T, Policy>;
+
+        /// @function `get_run_class`
+        /// @brief Returns the free run class of the given run length
+        ///
+        /// @param `run` The length of the free run
+        /// @return `size_t` The free run class, which is `floor(log2(run))`
+        static inline size_t get_run_class(const size_t run) {
+            return 63 - __builtin_clzll(run);
+        }
+
+        /// @function `create_block`
+        /// @brief Creates the block at the given index of the block table and adds it to the free space indices
+        ///
+        /// @param `block_id` The index of the block to create
+        void create_block(const size_t block_id) {
+            if constexpr (OPTIMISTIC_UPGRADES) {
+                retire_block(nullptr);
+                if constexpr (RANGED) {
+                    // A new block reuses the memory of the removed block of its id inside of the range, so that block has to be destroyed
+                    // first. Upgrades never wait for anything, so the ones still looking at it finish right away
+                    while (!retired_blocks.empty() || !expiring_blocks.empty()) {
+                        std::this_thread::yield();
+                        retire_block(nullptr);
+                    }
+                }
+            }
+            const size_t capacity = Capacities::get_capacity(block_id);
+            std::unique_ptr<Block<T>> block;
+            if constexpr (RANGED) {
+                const size_t size = Block<T>::get_memory_size(capacity);
+                void *memory = range.commit(get_range_offset(block_id), size);
+                block = Block<T>::create_in(memory, size, &Policy::memory::decommit, block_id, capacity);
+            } else {
+                block = Block<T>::template create<typename Policy::memory>(block_id, capacity);
+            }
+            block->set_owner(this, CACHED);
+            // The block is only published once it is fully set up
+            blocks.set(block_id, std::move(block));
+            if (block_run_classes.size() <= block_id) {
+                block_run_classes.resize(block_id + 1, NO_RUN_CLASS);
+            }
+            index_block(block_id);
+        }
+
+        /// @function `get_range_offset`
+        /// @brief Returns the offset of the block with the given id inside of the reserved address range, the blocks mutex must be held by
+        /// the caller
+        ///
+        /// @param `block_id` The id of the block
+        /// @return `size_t` The page aligned offset of the block
+        size_t get_range_offset(const size_t block_id) {
+            const size_t page_size = get_page_size();
+            if (range_offsets.empty()) {
+                range_offsets.push_back(0);
+            }
+            while (range_offsets.size() <= block_id) {
+                const size_t size = Block<T>::get_memory_size(Capacities::get_capacity(range_offsets.size() - 1));
+                range_offsets.push_back(range_offsets.back() + (size + page_size - 1) / page_size * page_size);
+            }
+            return range_offsets[block_id];
+        }
+
+        /// @function `create_free_block`
+        /// @brief Creates a new block which definitely has free slots, the blocks mutex must be held by the caller
+        ///
+        /// @return `size_t` The index of the created block
+        size_t create_free_block() {
+            // Try to cerate a block that isnt created yet in the current block table
+            for (size_t i = blocks.size(); i > 0; i--) {
+                if (blocks[i - 1] != nullptr) {
+                    continue;
+                }
+                create_block(i - 1);
+                return i - 1;
+            }
+
+            // If all blocks are full, create a new block with the calculated size, a new block definitely has space for a new variable
+            const size_t block_id = blocks.push_back();
+            create_block(block_id);
+            return block_id;
+        }
+
+        /// @function `allocate_in_block`
+        /// @brief Allocates a new variable in the given block, which must have a free slot, and removes the block from the set of non-full
+        /// blocks if it became full
+        ///
+        /// @param `block_id` The index of the block to allocate in
+        /// @param `args` The arguments with which to create the type T slot
+        /// @return `Var<T>` A variable node to the allocated object of type `T`
+        template <typename... Args> Var<T> allocate_in_block(const size_t block_id, Args &&...args) {
+            Block<T> *block_ptr = blocks[block_id];
+            Var<T> var = block_ptr->allocate(std::forward<Args>(args)...).value();
+            if (block_ptr->get_free_count() == 0) {
+                non_full_blocks.erase(block_id);
+            }
+            reuse_block(block_id);
+            return var;
+        }
+
+        /// @function `reserve_batch`
+        /// @brief Reserves up to `n` slots from the largest block which still has free slots, creating a new block if there is none. With
+        /// thread caches the blocks mutex must be held by the caller
+        ///
+        /// @param `reserved` The array the reserved slots are written to, it has to hold at least `n` slots
+        /// @param `n` The number of slots to reserve at most
+        /// @return `uint32_t` The number of reserved slots, which is at least 1
+        uint32_t reserve_batch(Slot<T> **reserved, const uint32_t n) {
+            if constexpr (CONCURRENT) {
+                // The rest of the batch is taken from the block the first slot came from, as far as that block has free slots left
+                reserved[0] = reserve_concurrent();
+                return 1 + static_cast<Block<T> *>(reserved[0]->get_owner())->reserve_slots(reserved + 1, n - 1);
+            }
+            size_t block_id = non_full_blocks.find_last();
+            if (block_id == BlockSet::NONE) {
+                std::unique_lock<Mutex> lock(blocks_mutex, std::defer_lock);
+                if constexpr (!CACHED) {
+                    lock.lock();
+                }
+                advance_epoch();
+                block_id = create_free_block();
+            }
+            Block<T> *block_ptr = blocks[block_id];
+            const uint32_t count = block_ptr->reserve_slots(reserved, n);
+            if (block_ptr->get_free_count() == 0) {
+                non_full_blocks.erase(block_id);
+            }
+            reuse_block(block_id);
+            return count;
+        }
+
+        /// @function `reserve_concurrent`
+        /// @brief Reserves a slot in the allocation block without the blocks mutex, see `default_policy::concurrent_blocks`. Only once the
+        /// allocation block is full, the mutex is taken to switch to another block
+        ///
+        /// @return `Slot<T> *` The reserved slot
+        Slot<T> *reserve_concurrent() {
+            while (true) {
+                const size_t block_id = allocation_block.load(std::memory_order_acquire);
+                // The allocation block only stops existing when `trim` destroyed it
+                Block<T> *block_ptr = block_id < blocks.size() ? blocks[block_id] : nullptr;
+                if (block_ptr != nullptr) {
+                    if (Slot<T> *slot = block_ptr->reserve_slot(); slot != nullptr) {
+                        return slot;
+                    }
+                }
+                switch_allocation_block(block_id);
+            }
+        }
+
+        /// @function `switch_allocation_block`
+        /// @brief Points the allocation block to the largest block with free slots, creating a new block if there is none. Of all threads
+        /// which found the same block full, only the first one switches it, the others retry with the block it switched to
+        ///
+        /// @param `full_id` The id of the allocation block which was found full
+        void switch_allocation_block(const size_t full_id) {
+            std::lock_guard<Mutex> lock(blocks_mutex);
+            if (allocation_block.load(std::memory_order_relaxed) != full_id) {
+                return;
+            }
+            for (size_t i = blocks.size(); i > 0; i--) {
+                Block<T> *block_ptr = blocks[i - 1];
+                if (block_ptr != nullptr && block_ptr->get_free_count() > 0) {
+                    allocation_block.store(i - 1, std::memory_order_release);
+                    return;
+                }
+            }
+            allocation_block.store(create_free_block(), std::memory_order_release);
+        }
+
+        /// @function `offer_block`
+        /// @brief Lets the concurrent allocations move on to the given block, which just gained free slots, if the allocation block is
+        /// full. This needs no lock, the allocations which still find the old block full switch it under the blocks mutex as usual
+        ///
+        /// @param `block` The block which gained free slots
+        void offer_block(Block<T> *block) {
+            size_t block_id = allocation_block.load(std::memory_order_acquire);
+            Block<T> *current = block_id < blocks.size() ? blocks[block_id] : nullptr;
+            if (current == nullptr || current->get_free_count() == 0) {
+                allocation_block.compare_exchange_strong(block_id, block->get_id(), std::memory_order_acq_rel);
+            }
+        }
+
+        /// @function `free_batch`
+        /// @brief Hands the given freed slots back to their blocks, in runs of neighbouring slots belonging to the same block. The slots
+        /// are not sorted, as that costs more than the per-slot bookkeeping a block saves for scattered slots
+        ///
+        /// @param `freed_slots` The freed slots, whose values have been destroyed already
+        /// @param `count` The number of slots
+        void free_batch(Slot<T> **freed_slots, const uint32_t count) {
+            uint32_t start = 0;
+            while (start < count) {
+                // Every slot of a head lives in one of its blocks
+                Block<T> *block = static_cast<Block<T> *>(freed_slots[start]->get_owner());
+                uint32_t end = start + 1;
+                while (end < count && freed_slots[end]->get_owner() == block) {
+                    end++;
+                }
+                // The block may be destroyed by this call once it is empty, which is why it is only called after the whole group is known
+                block->free_slots(freed_slots + start, end - start);
+                start = end;
+            }
+        }
+
+        /// @function `index_block`
+        /// @brief Updates the free space indices of the head for the block at the given index
+        ///
+        /// @param `block_id` The index of the block to index
+        void index_block(const size_t block_id) {
+            Block<T> *block_ptr = blocks[block_id];
+            if (block_ptr->get_free_count() > 0) {
+                non_full_blocks.insert(block_id);
+            } else {
+                non_full_blocks.erase(block_id);
+            }
+            const size_t run = block_ptr->get_largest_free_run_hint();
+            const uint8_t run_class = run == 0 ? NO_RUN_CLASS : get_run_class(run);
+            uint8_t &indexed_class = block_run_classes[block_id];
+            if (indexed_class == run_class) {
+                return;
+            }
+            if (indexed_class != NO_RUN_CLASS) {
+                free_run_blocks[indexed_class].erase(block_id);
+            }
+            if (run_class != NO_RUN_CLASS) {
+                free_run_blocks[run_class].insert(block_id);
+            }
+            indexed_class = run_class;
+        }
+
+        /// @function `unindex_block`
+        /// @brief Removes the block at the given index from all free space indices of the head
+        ///
+        /// @param `block_id` The index of the block to remove
+        void unindex_block(const size_t block_id) {
+            non_full_blocks.erase(block_id);
+            uint8_t &indexed_class = block_run_classes[block_id];
+            if (indexed_class != NO_RUN_CLASS) {
+                free_run_blocks[indexed_class].erase(block_id);
+                indexed_class = NO_RUN_CLASS;
+            }
+        }
 
         /// @function `block_emptied`
-        /// @brief The callback function which gets executed whenever a block gets emptied
+        /// @brief This function gets called from a block whenever it gets emptied
+        ///
+        /// @param `empty_block` The block which got emptied
+        void block_emptied(Block<T> *empty_block) override {
+            if constexpr (CONCURRENT) {
+                // Concurrent blocks are only destroyed by `trim`, as another thread may already be claiming a slot of this one again
+                offer_block(empty_block);
+            } else if constexpr (CACHED) {
+                // With thread caches, slots are only ever given back to their blocks while the blocks mutex is held already
+                retain_or_remove_block(empty_block);
+            } else {
+                std::lock_guard<Mutex> lock(blocks_mutex);
+                retain_or_remove_block(empty_block);
+            }
+        }
+
+        /// @function `block_gained_space`
+        /// @brief This function gets called from a block whenever a freed slot made it non-full or grew its largest free run hint
+        ///
+        /// @param `block` The block which gained free space
+        void block_gained_space(Block<T> *block) override {
+            if constexpr (CONCURRENT) {
+                offer_block(block);
+            } else {
+                index_block(block->get_id());
+            }
+        }
+
+        /// @function `retain_or_remove_block`
+        /// @brief Keeps the given empty block alive for later reuse if the retention policy allows it, otherwise destroys it. The blocks
+        /// mutex must be held by the caller
         ///
         /// @param `empty_block` The block which got emptied
-        void block_emptied(Block<T> *empty_block) {
-            std::lock_guard<std::mutex> lock(blocks_mutex);
+        void retain_or_remove_block(Block<T> *empty_block) {
+            const size_t id = empty_block->get_id();
+            if (retained_blocks.contains(id)) {
+                // A retained block becomes empty again when an array allocated in it throws, it simply stays retained
+                return;
+            }
+            advance_epoch();
+            const size_t bytes = empty_block->get_capacity() * SlotArray<T>::SLOT_SIZE;
+            if (retained_count >= Retention::max_blocks || bytes > Retention::max_bytes - retained_bytes) {
+                remove_block(empty_block);
+                return;
+            }
+            retained_blocks.insert(id);
+            retained_count++;
+            retained_bytes += bytes;
+            if (retained_since.size() <= id) {
+                retained_since.resize(id + 1);
+            }
+            retained_since[id] = epoch;
+            // The retained block is the emptiest block there is, so it is reused before any new block is created
+            index_block(id);
+        }
+
+        /// @function `reuse_block`
+        /// @brief Lets the retention policy know that a slot of the given block was handed out, so that block is no longer retained
+        ///
+        /// @param `block_id` The index of the block which was allocated from
+        inline void reuse_block(const size_t block_id) {
+            if constexpr (Retention::max_blocks > 0) {
+                if (retained_blocks.contains(block_id)) {
+                    retained_blocks.erase(block_id);
+                    retained_count--;
+                    retained_bytes -= blocks[block_id]->get_capacity() * SlotArray<T>::SLOT_SIZE;
+                }
+            }
+        }
+
+        /// @function `release_retained_block`
+        /// @brief Destroys the retained block at the given index, the blocks mutex must be held by the caller
+        ///
+        /// @param `block_id` The index of the retained block
+        void release_retained_block(const size_t block_id) {
+            Block<T> *block_ptr = blocks[block_id];
+            retained_blocks.erase(block_id);
+            retained_count--;
+            retained_bytes -= block_ptr->get_capacity() * SlotArray<T>::SLOT_SIZE;
+            remove_block(block_ptr);
+        }
+
+        /// @function `advance_epoch`
+        /// @brief Advances the allocation epoch and destroys all retained blocks which have been empty for too many epochs. An epoch passes
+        /// whenever the head's lock is taken for block bookkeeping, the blocks mutex must be held by the caller
+        void advance_epoch() {
+            if constexpr (Retention::max_blocks > 0 && Retention::epochs > 0) {
+                epoch++;
+                for (size_t id = retained_blocks.find_last(); id != BlockSet::NONE; id = retained_blocks.find_last(id)) {
+                    if (epoch - retained_since[id] >= Retention::epochs) {
+                        release_retained_block(id);
+                    }
+                }
+            }
+        }
+
+        /// @function `remove_block`
+        /// @brief Destroys the given empty block and shrinks the block table, the blocks mutex must be held by the caller
+        ///
+        /// @param `empty_block` The block to remove
+        void remove_block(Block<T> *empty_block) {
             size_t idx = empty_block->get_id();
 
             // Free the block
-            blocks[idx].reset();
+            unindex_block(idx);
+            if constexpr (OPTIMISTIC_UPGRADES) {
+                retire_block(blocks.release(idx));
+            } else {
+                blocks.reset(idx);
+            }
 
             // Remove all empty big blocks bigger than this block from the list
             for (size_t i = blocks.size() - 1; i > idx; i--) {
                 if (blocks[i] == nullptr) {
-                    blocks.resize(i); // Truncate the vector
+                    blocks.resize(i); // Truncate the table
                 } else {
                     break; // Stop at first non-empty block
                 }
@@ -203,8 +1013,8 @@ namespace dima {
             } else {
                 // Or, if all blocks are empty, clear everything
                 bool every_block_null = true;
-                for (const auto &block : blocks) {
-                    if (block != nullptr) {
+                for (size_t i = 0; i < blocks.size(); i++) {
+                    if (blocks[i] != nullptr) {
                         every_block_null = false;
                         break;
                     }
@@ -215,6 +1025,285 @@ namespace dima {
             }
         }
 
+        /// @function `retire_block`
+        /// @brief Destroys the given removed block once no upgrade can be looking at it anymore, see `upgrade`. The retired blocks of an
+        /// epoch expire when the next epoch starts, as every upgrade starting from then on cannot find them in the table anymore, and they
+        /// are destroyed by a later call once all upgrades of the earlier epoch have finished. The blocks mutex must be held by the caller
+        ///
+        /// @param `block` The removed block, nullptr to only destroy the blocks retired earlier
+        void retire_block(std::unique_ptr<Block<T>> block) {
+            if (block != nullptr) {
+                retired_blocks.push_back(std::move(block));
+            }
+            const size_t epoch = upgrade_epoch.load(std::memory_order_relaxed);
+            if (!expiring_blocks.empty()) {
+                if (active_upgrades[(epoch - 1) & 1].load(std::memory_order_seq_cst) != 0) {
+                    return;
+                }
+                expiring_blocks.clear();
+            }
+            if (retired_blocks.empty()) {
+                return;
+            }
+            upgrade_epoch.store(epoch + 1, std::memory_order_seq_cst);
+            expiring_blocks.swap(retired_blocks);
+            if (active_upgrades[epoch & 1].load(std::memory_order_seq_cst) == 0) {
+                expiring_blocks.clear();
+            }
+        }
+
+        /// @function `is_sparse_block`
+        /// @brief Checks whether the given block is occupied sparsely enough to be emptied by compaction, see `incremental_compaction`
+        ///
+        /// @param `block` The block to check
+        /// @return `bool` Whether the block is sparse, is not empty and holds no pinned values
+        bool is_sparse_block(Block<T> *block) {
+            const size_t count = block->get_allocation_count();
+            return count > 0 && block->get_pinned_count() == 0 && count * 100 <= block->get_capacity() * Compaction::max_source_occupancy;
+        }
+
+        /// @function `find_compaction_source`
+        /// @brief Finds the next sparse block at or after the compaction cursor
+        ///
+        /// @return `Block<T> *` The next sparse block, nullptr if there is none
+        Block<T> *find_compaction_source() {
+            for (; compact_cursor < blocks.size(); compact_cursor++) {
+                if (Block<T> *block = blocks[compact_cursor]; block != nullptr && is_sparse_block(block)) {
+                    return block;
+                }
+            }
+            return nullptr;
+        }
+
+        /// @function `find_compaction_target`
+        /// @brief Finds a block with free slots which holds at least as many values as the given source block. Values only ever move into
+        /// blocks at least as dense as the block they come from, so no value moves back and forth between two blocks
+        ///
+        /// @param `source` The block the values are moved out of
+        /// @return `Block<T> *` The block to move the values into, nullptr if there is none
+        Block<T> *find_compaction_target(Block<T> *source) {
+            const size_t count = source->get_allocation_count();
+            for (size_t id = non_full_blocks.find_last(); id != BlockSet::NONE; id = non_full_blocks.find_last(id)) {
+                Block<T> *block = blocks[id];
+                if (block != source && block->get_allocation_count() >= count) {
+                    return block;
+                }
+            }
+            return nullptr;
+        }
+
+        /// @function `upgrade_slot`
+        /// @brief Retains the slot at the given index of the block with the given id if it still holds the value of the given generation
+        /// inside of the incarnation of the block the caller expects, see `upgrade`
+        ///
+        /// @param `block_id` The id of the block of the value
+        /// @param `slot_index` The index of the slot of the value inside of its block
+        /// @param `generation` The generation the slot has to have
+        /// @param `is_incarnation` The function checking whether a block is in the incarnation the value was allocated in
+        /// @return `std::optional<Var<T>>` A variable to the value, nullopt if the value is gone
+        template <typename IsIncarnation>
+        std::optional<Var<T>> upgrade_slot(const size_t block_id, const uint32_t slot_index, const uint32_t generation,
+            IsIncarnation &&is_incarnation) {
+            static_assert(Slot<T>::WEAK, "Only types with weak_references enabled in their policy can have weak references");
+            Slot<T> *slot = nullptr;
+            if constexpr (OPTIMISTIC_UPGRADES) {
+                std::atomic<size_t> &active = enter_upgrade();
+                Block<T> *block = block_id < blocks.size() ? blocks.load(block_id) : nullptr;
+                const bool retained = block != nullptr && is_incarnation(block) &&
+                    (slot = block->get_slot(slot_index))->get_generation() == generation && slot->try_retain();
+                active.fetch_sub(1, std::memory_order_release);
+                if (!retained) {
+                    return std::nullopt;
+                }
+                // The value could have been replaced between the looks at the block and the slot, even by a value of a later incarnation of
+                // the block, the reference to a newer value is dropped right away
+                Var<T> var(slot);
+                if (!is_incarnation(block) || slot->get_generation() != generation) {
+                    return std::nullopt;
+                }
+                return var;
+            } else {
+                std::unique_lock<Mutex> lock(blocks_mutex);
+                Block<T> *block = block_id < blocks.size() ? blocks[block_id] : nullptr;
+                if (block == nullptr || !is_incarnation(block)) {
+                    return std::nullopt;
+                }
+                slot = block->get_slot(slot_index);
+                if (slot->get_generation() != generation || !slot->try_retain()) {
+                    return std::nullopt;
+                }
+                // The variable is linked to the slot while compaction cannot move the value, and the value cannot be replaced anymore once
+                // it is retained
+                Var<T> var(slot);
+                const bool current = slot->get_generation() == generation;
+                // The reference keeps the block alive, and dropping it again may destroy the block, which needs the blocks mutex
+                lock.unlock();
+                if (!current) {
+                    return std::nullopt;
+                }
+                return var;
+            }
+        }
+
+        /// @function `enter_upgrade`
+        /// @brief Counts the calling upgrade in the current upgrade epoch before it looks at any block. A block removed before the epoch
+        /// started has left the table already, and a block removed later is not destroyed before the count of this epoch dropped to zero.
+        /// If the epoch advances while the upgrade counts itself, it counts itself in the new one instead
+        ///
+        /// @return `std::atomic<size_t> &` The count of running upgrades the calling upgrade has to leave again once it is done
+        std::atomic<size_t> &enter_upgrade() {
+            size_t epoch = upgrade_epoch.load(std::memory_order_seq_cst);
+            while (true) {
+                std::atomic<size_t> &active = active_upgrades[epoch & 1];
+                active.fetch_add(1, std::memory_order_seq_cst);
+                const size_t current = upgrade_epoch.load(std::memory_order_seq_cst);
+                if (current == epoch) {
+                    return active;
+                }
+                active.fetch_sub(1, std::memory_order_release);
+                epoch = current;
+            }
+        }
+
+        /// @function `get_thread_cache`
+        /// @brief Returns the cache of the calling thread for this head
+        ///
+        /// @return `ThreadCache<T, Policy> &` The cache of the calling thread
+        ThreadCache<T, Policy> &get_thread_cache() {
+            thread_local ThreadCacheRegistry<T, Policy> registry;
+            return registry.get(this, head_id);
+        }
+
+        /// @function `register_thread_cache`
+        /// @brief Registers a newly created thread cache at this head
+        ///
+        /// @param `cache` The thread cache to register
+        void register_thread_cache(ThreadCache<T, Policy> &cache) {
+            std::lock_guard<Mutex> lock(blocks_mutex);
+            thread_caches.push_back(&cache);
+        }
+
+        /// @function `drop_thread_cache`
+        /// @brief Gives all slots of the given thread cache back to their blocks and unregisters the cache, as its thread has ended
+        ///
+        /// @param `cache` The thread cache to drop
+        void drop_thread_cache(ThreadCache<T, Policy> &cache) {
+            std::lock_guard<Mutex> lock(blocks_mutex);
+            for (auto *entry = cache.pop(); entry != nullptr; entry = cache.pop()) {
+                // A block can only become empty (and be destroyed) once the last of its slots is back, so no later entry refers to it
+                entry->block->free_slot(entry->slot);
+            }
+            thread_caches.erase(std::find(thread_caches.begin(), thread_caches.end(), &cache));
+        }
+
+        /// @function `refill_thread_cache`
+        /// @brief Refills the given (empty) thread cache. Slots released by other threads are taken first, which needs no lock at all, only
+        /// if there are none a batch of empty slots is reserved from the blocks, creating new blocks if needed
+        ///
+        /// @param `cache` The thread cache to refill
+        void refill_thread_cache(ThreadCache<T, Policy> &cache) {
+            if (collect_remote_frees(cache)) {
+                return;
+            }
+            std::lock_guard<Mutex> lock(blocks_mutex);
+            advance_epoch();
+            for (uint32_t i = 0; i < REFILL_COUNT; i++) {
+                size_t block_id = non_full_blocks.find_last();
+                if (block_id == BlockSet::NONE) {
+                    block_id = create_free_block();
+                }
+                Block<T> *block_ptr = blocks[block_id];
+                cache.push({block_ptr, block_ptr->reserve_slot()});
+                reuse_block(block_id);
+                if (block_ptr->get_free_count() == 0) {
+                    non_full_blocks.erase(block_id);
+                }
+            }
+        }
+
+        /// @function `push_remote_free`
+        /// @brief Pushes a released slot onto the remote free list of its block, and the block onto the list of blocks with remote frees
+        /// if its remote free list was empty before. Neither needs a lock
+        ///
+        /// @param `block` The block the released slot belongs to
+        /// @param `slot` The released slot
+        void push_remote_free(Block<T> *block, Slot<T> *slot) {
+            if (!block->push_remote_free(slot)) {
+                return;
+            }
+            // A block is only pushed once its remote free list became non-empty, and it is only taken from this list before its remote
+            // free list is taken, so it is never on this list twice
+            Block<T> *head = remote_blocks.load(std::memory_order_relaxed);
+            do {
+                block->next_remote_block = head;
+            } while (!remote_blocks.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        /// @function `collect_remote_frees`
+        /// @brief Moves the slots of all remote free lists into the given thread cache, which needs no lock. Only the slots which do not
+        /// fit into the cache anymore are given back to their blocks under the lock, so they can be found by all threads again
+        ///
+        /// @param `cache` The thread cache to move the slots into
+        /// @return `bool` Whether at least one slot was moved into the cache
+        bool collect_remote_frees(ThreadCache<T, Policy> &cache) {
+            if (remote_free_count.load(std::memory_order_relaxed) == 0) {
+                return false;
+            }
+            std::unique_lock<Mutex> lock(blocks_mutex, std::defer_lock);
+            Block<T> *block = remote_blocks.exchange(nullptr, std::memory_order_acquire);
+            size_t taken = 0;
+            bool collected = false;
+            while (block != nullptr) {
+                Block<T> *next_block = block->next_remote_block;
+                uint32_t idx = block->take_remote_frees();
+                while (idx != Block<T>::NO_SLOT) {
+                    Slot<T> *slot = block->get_slot(idx);
+                    idx = slot->get_link().next;
+                    taken++;
+                    if (cache.push({block, slot})) {
+                        collected = true;
+                        continue;
+                    }
+                    if (!lock.owns_lock()) {
+                        lock.lock();
+                    }
+                    // The block can only become empty (and be destroyed) with its last slot, so no later slot of this list refers to it
+                    block->free_slot(slot);
+                }
+                block = next_block;
+            }
+            remote_free_count.fetch_sub(taken, std::memory_order_relaxed);
+            return collected;
+        }
+
+        /// @function `slot_released`
+        /// @brief This function gets called from a block whenever one of its slots is released while thread caches are used. The slot
+        /// is kept in the cache of the releasing thread. If that cache is full, the slot is pushed onto the remote free list of its block
+        /// instead, from where the next thread which runs out of slots takes it, so a thread which only releases (for example the consumer
+        /// of a producer / consumer pipeline) never touches the metadata of any block and never takes the lock
+        ///
+        /// @param `block` The block the released slot belongs to
+        /// @param `slot` The released slot
+        void slot_released(Block<T> *block, Slot<T> *slot) override {
+            ThreadCache<T, Policy> &cache = get_thread_cache();
+            if (!cache.push({block, slot})) {
+                remote_free_count.fetch_add(1, std::memory_order_relaxed);
+                push_remote_free(block, slot);
+            }
+        }
+
+        /// @function `get_cached_count`
+        /// @brief Returns the number of free slots kept in thread caches and remote free lists, the blocks mutex must be held by the caller
+        ///
+        /// @return `size_t` The number of slots in all thread caches and remote free lists
+        size_t get_cached_count() {
+            size_t count = remote_free_count.load(std::memory_order_relaxed);
+            for (const ThreadCache<T, Policy> *cache : thread_caches) {
+                count += cache->get_size();
+            }
+            return count;
+        }
+
         // Here are the non-core public functions. Everything above cannot be removed, these are additional functions publically available
         // to call
       public:
@@ -223,13 +1312,15 @@ namespace dima {
         ///
         /// @return `size_t` The number of all allocated variables
         size_t get_allocation_count() {
+            std::lock_guard<Mutex> lock(blocks_mutex);
             size_t count = 0;
-            for (auto &block : blocks) {
-                if (block != nullptr) {
+            for (size_t i = 0; i < blocks.size(); i++) {
+                if (Block<T> *block = blocks[i]; block != nullptr) {
                     count += block->get_allocation_count();
                 }
             }
-            return count;
+            // Slots kept in thread caches are occupied for their blocks, but they do not hold any variable
+            return count - get_cached_count();
         }
 
         /// @function `get_free_count`
@@ -237,13 +1328,14 @@ namespace dima {
         ///
         /// @return `size_t` The number of free slots in all blocks
         size_t get_free_count() {
+            std::lock_guard<Mutex> lock(blocks_mutex);
             size_t count = 0;
-            for (auto &block : blocks) {
-                if (block != nullptr) {
+            for (size_t i = 0; i < blocks.size(); i++) {
+                if (Block<T> *block = blocks[i]; block != nullptr) {
                     count += block->get_free_count();
                 }
             }
-            return count;
+            return count + get_cached_count();
         }
 
         /// @function `get_capacity`
@@ -251,9 +1343,10 @@ namespace dima {
         ///
         /// @return `size_t` The total capacity among all DIMA blocks
         size_t get_capacity() {
+            std::lock_guard<Mutex> lock(blocks_mutex);
             size_t count = 0;
-            for (auto &block : blocks) {
-                if (block != nullptr) {
+            for (size_t i = 0; i < blocks.size(); i++) {
+                if (Block<T> *block = blocks[i]; block != nullptr) {
                     count += block->get_capacity();
                 }
             }
@@ -267,8 +1360,8 @@ namespace dima {
         template <typename Func> void parallel_foreach(Func &&func) {
             // #pragma omp parallel for
             for (size_t i = 0; i < blocks.size(); i++) {
-                if (blocks.at(i) != nullptr) {
-                    blocks.at(i)->apply_to_all_slots(std::forward<Func>(func));
+                if (Block<T> *block = blocks[i]; block != nullptr) {
+                    block->apply_to_all_slots(std::forward<Func>(func));
                 }
             }
         }
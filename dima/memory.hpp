@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define DIMA_HAS_MMAP
+#endif
+
+/// @namespace `dima`
+/// @brief The `dima` namespace contains all classes used for the DIMA memory management system
+namespace dima {
+
+    /// @function `get_page_size`
+    /// @brief Returns the page size of the system
+    ///
+    /// @return `size_t` The page size in bytes
+    inline size_t get_page_size() {
+#if defined(DIMA_HAS_MMAP)
+        static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return page_size;
+#else
+        return 4096;
+#endif
+    }
+
+    /// @struct `heap_memory`
+    /// @brief A memory provider which takes the memory of blocks from the global heap. Freed blocks go back to the heap, which may keep
+    /// them around for later allocations instead of giving them back to the OS
+    struct heap_memory {
+        static void *allocate(const size_t size, const size_t alignment) {
+            return ::operator new(size, std::align_val_t(alignment));
+        }
+
+        static void deallocate(void *memory, const size_t, const size_t alignment) {
+            ::operator delete(memory, std::align_val_t(alignment));
+        }
+    };
+
+#if defined(DIMA_HAS_MMAP)
+    /// @struct `mmap_memory`
+    /// @brief A memory provider which maps every block as its own anonymous memory region. The pages of a block only become resident once
+    /// they are touched, and a freed block is unmapped right away, so its memory goes straight back to the OS. With `Populate` all pages
+    /// are faulted in when the block is created (`MAP_POPULATE`, where available), which moves the page faults out of the allocations
+    template <bool Populate = false> struct mmap_memory {
+        static void *allocate(const size_t size, const size_t alignment) {
+            // Mappings are always aligned to the page size, which is larger than the alignment of any block
+            if (alignment > get_page_size()) {
+                throw std::bad_alloc();
+            }
+            int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_POPULATE)
+            if constexpr (Populate) {
+                flags |= MAP_POPULATE;
+            }
+#endif
+            void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+            if (memory == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            return memory;
+        }
+
+        static void deallocate(void *memory, const size_t size, const size_t) {
+            munmap(memory, size);
+        }
+    };
+
+    /// @struct `huge_page_memory`
+    /// @brief A memory provider which backs large blocks with transparent huge pages, which cuts the TLB misses of heads spanning many
+    /// gigabytes. Blocks of at least `MinBytes` bytes are mapped at a huge page boundary and advised with `MADV_HUGEPAGE`, all smaller
+    /// blocks are mapped like `mmap_memory` does. With `Populate` all pages are faulted in when the block is created
+    template <size_t MinBytes = 2 * 1024 * 1024, bool Populate = false> struct huge_page_memory {
+        /// @var `HUGE_PAGE_SIZE`
+        /// @brief The size of a transparent huge page
+        static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+        static void *allocate(const size_t size, const size_t alignment) {
+            if (size < MinBytes) {
+                return mmap_memory<Populate>::allocate(size, alignment);
+            }
+            // Map one huge page more than needed and cut the mapping down to a huge page aligned region, the kernel only backs aligned
+            // regions with huge pages
+            const size_t mapped_size = get_mapped_size(size);
+            void *mapping = mmap(nullptr, mapped_size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mapping == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            const uintptr_t start = reinterpret_cast<uintptr_t>(mapping);
+            const uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+            if (aligned != start) {
+                munmap(mapping, aligned - start);
+            }
+            if (const size_t tail = start + mapped_size + HUGE_PAGE_SIZE - (aligned + mapped_size); tail != 0) {
+                munmap(reinterpret_cast<void *>(aligned + mapped_size), tail);
+            }
+            void *memory = reinterpret_cast<void *>(aligned);
+#if defined(MADV_HUGEPAGE)
+            madvise(memory, mapped_size, MADV_HUGEPAGE);
+#endif
+            if constexpr (Populate) {
+#if defined(MADV_POPULATE_WRITE)
+                if (madvise(memory, mapped_size, MADV_POPULATE_WRITE) == 0) {
+                    return memory;
+                }
+#endif
+                // Older kernels cannot prefault through madvise, so every page is touched once instead
+                const size_t page_size = get_page_size();
+                for (size_t offset = 0; offset < mapped_size; offset += page_size) {
+                    static_cast<volatile char *>(memory)[offset] = 0;
+                }
+            }
+            return memory;
+        }
+
+        static void deallocate(void *memory, const size_t size, const size_t alignment) {
+            if (size < MinBytes) {
+                mmap_memory<Populate>::deallocate(memory, size, alignment);
+                return;
+            }
+            munmap(memory, get_mapped_size(size));
+        }
+
+      private:
+        /// @function `get_mapped_size`
+        /// @brief Returns the size of the mapping of a huge page backed block, which is rounded up to whole huge pages
+        static constexpr size_t get_mapped_size(const size_t size) {
+            return (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        }
+    };
+
+    /// @class `reserved_range_memory`
+    /// @brief A memory provider which reserves one large range of address space up front and commits the blocks of a head consecutively
+    /// inside of it, every block id at its own fixed position. All slots of the head then live in a single ascending address range in
+    /// block order, which makes scans over a whole type run through memory sequentially, and creating a block does not allocate at all.
+    /// A destroyed block is decommitted with `MADV_DONTNEED`, which gives its pages back to the OS while its addresses stay reserved.
+    /// Unlike all other providers this one has state, so every head owns its own instance of it
+    template <size_t ReserveBytes = size_t(1) << 36> class reserved_range_memory {
+      public:
+        reserved_range_memory() :
+            base(static_cast<std::byte *>(mmap(nullptr, ReserveBytes, PROT_NONE, get_reserve_flags(), -1, 0))) {
+            if (base == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+        }
+
+        reserved_range_memory(const reserved_range_memory &) = delete;
+        reserved_range_memory &operator=(const reserved_range_memory &) = delete;
+
+        ~reserved_range_memory() {
+            munmap(base, ReserveBytes);
+        }
+
+        /// @function `commit`
+        /// @brief Makes the given part of the range usable. Its pages only become resident once they are touched
+        ///
+        /// @param `offset` The page aligned offset of the part from the start of the range
+        /// @param `size` The size of the part
+        /// @return `void *` The start of the committed part
+        void *commit(const size_t offset, const size_t size) {
+            if (offset + size > ReserveBytes || mprotect(base + offset, size, PROT_READ | PROT_WRITE) != 0) {
+                throw std::bad_alloc();
+            }
+            return base + offset;
+        }
+
+        /// @function `decommit`
+        /// @brief Gives the pages of a committed part back to the OS, the part stays usable and reads as zero afterwards
+        static void decommit(void *memory, const size_t size, const size_t) {
+            madvise(memory, size, MADV_DONTNEED);
+        }
+
+      private:
+        /// @var `base`
+        /// @brief The start of the reserved range
+        std::byte *base;
+
+        /// @function `get_reserve_flags`
+        /// @brief Returns the flags of the reserving mapping, which never counts against the commit limit of the system
+        static constexpr int get_reserve_flags() {
+#if defined(MAP_NORESERVE)
+            return MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+#else
+            return MAP_PRIVATE | MAP_ANONYMOUS;
+#endif
+        }
+    };
+#endif
+
+    /// @struct `is_reserved_range`
+    /// @brief Whether the given memory provider is a `reserved_range_memory`, whose instances are owned by the heads
+    template <typename Memory> struct is_reserved_range : std::false_type {};
+
+#if defined(DIMA_HAS_MMAP)
+    template <size_t ReserveBytes> struct is_reserved_range<reserved_range_memory<ReserveBytes>> : std::true_type {};
+#endif
+} // namespace dima
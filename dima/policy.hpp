@@ -0,0 +1,403 @@
+#pragma once
+
+#include "memory.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/// @namespace `dima`
+/// @brief The `dima` namespace contains all classes used for the DIMA memory management system
+namespace dima {
+
+    /// @var `MAX_BLOCK_CAPACITY`
+    /// @brief The largest capacity a single block can have, as slot indices within a block are 32 Bit values
+    static constexpr size_t MAX_BLOCK_CAPACITY = UINT32_MAX - 1;
+
+    /// @struct `geometric_growth`
+    /// @brief A sizing policy where every block is `Numerator / Denominator` times as large as the block before it, rounded up. The
+    /// default of 11 / 10 with a base capacity of 16 mirrors the C library's growth curve
+    template <size_t Numerator = 11, size_t Denominator = 10, size_t BaseCapacity = 16> struct geometric_growth {
+        static_assert(Numerator >= Denominator, "A geometric growth factor smaller than 1 would shrink the blocks");
+        static_assert(BaseCapacity > 0, "The base capacity must be at least 1");
+
+        static constexpr size_t get_base_capacity(const size_t) {
+            return BaseCapacity;
+        }
+
+        static constexpr size_t get_next_capacity(const size_t capacity, const size_t) {
+            return (capacity * Numerator + Denominator - 1) / Denominator;
+        }
+    };
+
+    /// @struct `doubling_growth`
+    /// @brief A sizing policy where every block is twice as large as the block before it
+    template <size_t BaseCapacity = 16> struct doubling_growth : geometric_growth<2, 1, BaseCapacity> {};
+
+    /// @struct `fixed_capacity`
+    /// @brief A sizing policy where all blocks have the exact same capacity
+    template <size_t Capacity> struct fixed_capacity {
+        static_assert(Capacity > 0 && Capacity <= MAX_BLOCK_CAPACITY, "The fixed capacity must fit into a block");
+
+        static constexpr size_t get_base_capacity(const size_t) {
+            return Capacity;
+        }
+
+        static constexpr size_t get_next_capacity(const size_t capacity, const size_t) {
+            return capacity;
+        }
+    };
+
+    /// @struct `byte_budget_growth`
+    /// @brief A sizing policy which sizes blocks by their byte size instead of their slot count, which suits large types. The first block
+    /// gets `BaseBytes` bytes, every following block `Numerator / Denominator` times the bytes of the block before it, up to `MaxBytes`
+    /// bytes per block. Every block holds at least one slot
+    template <size_t BaseBytes = 64 * 1024, size_t Numerator = 2, size_t Denominator = 1, size_t MaxBytes = 64 * 1024 * 1024> //
+    struct byte_budget_growth {
+        static_assert(Numerator >= Denominator, "A growth factor smaller than 1 would shrink the blocks");
+        static_assert(BaseBytes <= MaxBytes, "The base byte budget cannot exceed the maximum byte budget");
+
+        static constexpr size_t get_base_capacity(const size_t slot_size) {
+            return BaseBytes / slot_size > 0 ? BaseBytes / slot_size : 1;
+        }
+
+        static constexpr size_t get_next_capacity(const size_t capacity, const size_t slot_size) {
+            const size_t bytes = (capacity * slot_size * Numerator + Denominator - 1) / Denominator;
+            const size_t budget = bytes < MaxBytes ? bytes : MaxBytes;
+            return budget / slot_size > capacity ? budget / slot_size : capacity;
+        }
+    };
+
+    /// @struct `page_budget_growth`
+    /// @brief A byte budget sizing policy expressed in 4 KiB pages
+    template <size_t BasePages = 16, size_t Numerator = 2, size_t Denominator = 1, size_t MaxPages = 16 * 1024> //
+    struct page_budget_growth : byte_budget_growth<BasePages * 4096, Numerator, Denominator, MaxPages * 4096> {};
+
+    /// @struct `keep_empty_blocks`
+    /// @brief A retention policy which keeps blocks alive after they became empty, so a workload oscillating around a block boundary
+    /// reuses them instead of destroying and constructing blocks over and over. At most `MaxBlocks` empty blocks with at most `MaxBytes`
+    /// bytes of slots in total are kept. If `Epochs` is not 0, a kept block is destroyed once it has stayed empty for `Epochs` allocation
+    /// epochs, where an epoch passes whenever the head has to go to its blocks for new slots
+    template <size_t MaxBlocks, size_t MaxBytes = SIZE_MAX, size_t Epochs = 0> struct keep_empty_blocks {
+        static constexpr size_t max_blocks = MaxBlocks;
+        static constexpr size_t max_bytes = MaxBytes;
+        static constexpr size_t epochs = Epochs;
+    };
+
+    /// @struct `no_retention`
+    /// @brief A retention policy which destroys every block the moment it becomes empty
+    struct no_retention : keep_empty_blocks<0> {};
+
+    /// @struct `interleaved_layout`
+    /// @brief A slot layout where every value is stored inside of its slot, right next to its reference count. One allocation gets a
+    /// single cache line for both, which is why this is the default
+    struct interleaved_layout {
+        static constexpr bool split = false;
+    };
+
+    /// @struct `split_layout`
+    /// @brief A slot layout where the slots of a block (reference count, flags and index) are stored in one dense array and their values
+    /// in a second array at `sizeof(T)` stride. Iterating over the values of a block then never touches slot headers, and changing a
+    /// reference count never writes to a cache line holding values, so it suits types which are mostly iterated over or shared between
+    /// threads. The values of types smaller than 8 bytes are padded to 8 bytes, as free slots keep their free list links in them
+    struct split_layout {
+        static constexpr bool split = true;
+    };
+
+    /// @struct `no_compaction`
+    /// @brief A compaction policy under which live values never move, so nothing has to keep track of the variables referring to them
+    struct no_compaction {
+        static constexpr bool enabled = false;
+        static constexpr size_t max_source_occupancy = 0;
+    };
+
+    /// @struct `incremental_compaction`
+    /// @brief A compaction policy which lets the head move live values out of sparsely occupied blocks into denser ones, see
+    /// `Head::compact`. A block counts as sparse while at most `MaxOccupancy` percent of its slots are occupied. To redirect the variables
+    /// of a moved value, every slot keeps a list of all variables referring to it, which makes copying and destroying a variable a few
+    /// pointer writes more expensive. The variables of such a type must therefore not be copied or destroyed concurrently, which is why
+    /// compaction cannot be combined with thread caches
+    template <size_t MaxOccupancy = 25> struct incremental_compaction {
+        static_assert(MaxOccupancy > 0 && MaxOccupancy < 100, "The occupancy of sparse blocks has to be a percentage between 0 and 100");
+
+        static constexpr bool enabled = true;
+        static constexpr size_t max_source_occupancy = MaxOccupancy;
+    };
+
+    /// @struct `default_policy`
+    /// @brief The policy used for all DIMA types which do not specify their own one. A custom policy is created by inheriting from this
+    /// struct and shadowing the members which should differ, for example
+    ///
+    /// ```cpp
+    /// struct LargePolicy : dima::default_policy {
+    ///     using sizing = dima::byte_budget_growth<1024 * 1024>;
+    /// };
+    /// class Large : public dima::Type<Large, LargePolicy> { ... };
+    /// ```
+    struct default_policy {
+        /// @brief The growth curve of the block capacities
+        using sizing = geometric_growth<>;
+
+        /// @brief Which empty blocks are kept alive for later reuse instead of being destroyed right away
+        using retention = no_retention;
+
+        /// @brief Whether the values are stored inside of their slots (`interleaved_layout`) or apart from them (`split_layout`)
+        using layout = interleaved_layout;
+
+        /// @brief Where the memory of the blocks comes from, either `heap_memory` (the default), `mmap_memory` or `huge_page_memory`
+        using memory = heap_memory;
+
+        /// @brief Whether live values can be moved between blocks to give sparsely occupied blocks back, either `no_compaction` (the
+        /// default) or `incremental_compaction`
+        using compaction = no_compaction;
+
+        /// @brief How many free slots every thread keeps reserved for itself. When this is 0 (the default) neither allocating a value nor
+        /// handing the slot of a destroyed value back to its block is synchronized, so only one thread at a time may allocate values or
+        /// release last references. Otherwise every thread allocates from and releases into its own cache without any locking. Slots
+        /// released while a cache is full go onto lock-free remote free lists, from which other threads refill their caches before
+        /// locking the head. Together with `concurrent_blocks` this is one of the two ways the blocks of a head are shared between
+        /// threads, see `multi_threaded`
+        static constexpr size_t thread_cache_size = 0;
+
+        /// @brief Whether all threads claim the slots of their values in shared blocks at once, without thread caches. Every allocation
+        /// then takes a slot of the head's current allocation block by counting it and claiming a bit of the block's occupancy bitmap
+        /// with atomic operations, and every release clears the bit and uncounts the slot the same way, so no lock is taken until the
+        /// allocation block is full and another one has to be picked. Blocks which become empty are kept until `Head::trim`, as another
+        /// thread may be claiming one of their slots at any time. Such a type cannot have arrays, weak references, compaction, a
+        /// retention policy or thread caches, see `concurrent`
+        static constexpr bool concurrent_blocks = false;
+
+        /// @brief Whether the values of this type may be shared between threads. When this is true the reference counts of the slots are
+        /// atomics, so `Var`s of the same value can be copied and released on many threads at once, but without thread caches the blocks
+        /// themselves are still not synchronized (see `thread_cache_size` and `concurrent_blocks`). When this is false the reference counts are plain integers
+        /// and the head never takes a lock, so every `Var` copy and every release is a plain increment or decrement. Such a type must
+        /// never be allocated, copied or released on more than one thread
+        static constexpr bool thread_safe = true;
+
+        /// @brief Whether the references of the thread which allocated a value are counted apart from all other references. That thread
+        /// changes its own count without any atomic operation, all other threads use an atomic shared count, and both are merged once
+        /// the allocating thread dropped all of its references. This suits values which mostly stay on one thread but are shared now and
+        /// then. A reference counted by the allocating thread but released on another thread is handed back to the allocating thread,
+        /// which drops it on its next allocation of a biased type or in `BiasedThreads::collect`
+        static constexpr bool biased_references = false;
+
+        /// @brief Whether `WeakVar`s of this type can be created. Every slot then keeps a generation number which changes whenever its
+        /// value is destroyed, so a weak variable can tell whether its slot still holds the value it was created from. This makes every
+        /// slot 4 bytes larger
+        static constexpr bool weak_references = false;
+
+        /// @brief Whether a value whose last reference is released is destroyed later instead of right away. The value is then queued on
+        /// the releasing thread, and that thread destroys it and frees its slot in `dima::reclaim`, which stops after a time or value
+        /// budget. Values released by a destructor running in `reclaim` are queued too, so tearing down a large graph of values never
+        /// pauses the program for longer than the budget. Values are only destroyed when their thread calls `reclaim` or exits
+        static constexpr bool deferred_reclamation = false;
+    };
+
+    /// @struct `multi_threaded`
+    /// @brief A policy for types which are allocated and released from many threads at once
+    struct multi_threaded : default_policy {
+        static constexpr size_t thread_cache_size = 64;
+    };
+
+    /// @struct `concurrent`
+    /// @brief A policy for types which are allocated and released from many threads at once without keeping slots in thread caches, see
+    /// `default_policy::concurrent_blocks`
+    struct concurrent : default_policy {
+        static constexpr bool concurrent_blocks = true;
+    };
+
+    /// @struct `single_threaded`
+    /// @brief A policy for types which never leave the thread they are allocated on, see `default_policy::thread_safe`
+    struct single_threaded : default_policy {
+        static constexpr bool thread_safe = false;
+    };
+
+    /// @struct `thread_biased`
+    /// @brief A policy for types which mostly stay on the thread they are allocated on, see `default_policy::biased_references`
+    struct thread_biased : default_policy {
+        static constexpr bool biased_references = true;
+    };
+
+    /// @struct `deferred`
+    /// @brief A policy for types whose values are destroyed in budgeted steps through `dima::reclaim`, see
+    /// `default_policy::deferred_reclamation`
+    struct deferred : default_policy {
+        static constexpr bool deferred_reclamation = true;
+    };
+
+    /// @struct `type_policy`
+    /// @brief The policy of the type `T`, which is its own policy if it is a `dima::Type` and `default_policy` otherwise
+    template <typename T, typename = void> struct type_policy {
+        using type = default_policy;
+    };
+
+    template <typename T> struct type_policy<T, std::void_t<typename T::dima_policy>> {
+        using type = typename T::dima_policy;
+    };
+
+    /// @struct `slot_layout`
+    /// @brief The slot layout of the type `T`, see `type_policy`
+    template <typename T> struct slot_layout : type_policy<T>::type::layout {};
+
+    /// @struct `slot_compaction`
+    /// @brief The compaction policy of the type `T`, see `type_policy`
+    template <typename T> struct slot_compaction : type_policy<T>::type::compaction {};
+
+    /// @class `CapacityTable`
+    /// @brief The block capacities and their prefix sums of a sizing policy for a given slot size, computed at compile time. The table
+    /// holds every block until the curve stops growing (or reaches `MAX_BLOCK_CAPACITY`), all blocks after the table have the capacity of
+    /// the last table entry, so every lookup is either a table access or a closed form calculation
+    template <typename Sizing, size_t SlotSize> class CapacityTable {
+      private:
+        /// @function `clamp`
+        /// @brief Clamps the given capacity to the capacity range a block can hold
+        static constexpr size_t clamp(const size_t capacity) {
+            return capacity == 0 ? 1 : (capacity > MAX_BLOCK_CAPACITY ? MAX_BLOCK_CAPACITY : capacity);
+        }
+
+        /// @function `count_entries`
+        /// @brief Counts how many blocks the curve needs until it stops growing
+        static constexpr size_t count_entries() {
+            size_t count = 1;
+            size_t capacity = clamp(Sizing::get_base_capacity(SlotSize));
+            for (size_t next = clamp(Sizing::get_next_capacity(capacity, SlotSize)); next > capacity;
+                 next = clamp(Sizing::get_next_capacity(capacity, SlotSize))) {
+                capacity = next;
+                count++;
+            }
+            return count;
+        }
+
+      public:
+        /// @var `ENTRY_COUNT`
+        /// @brief The number of growing blocks stored in the table
+        static constexpr size_t ENTRY_COUNT = count_entries();
+
+      private:
+        static constexpr std::array<size_t, ENTRY_COUNT> build_capacities() {
+            std::array<size_t, ENTRY_COUNT> capacities{};
+            capacities[0] = clamp(Sizing::get_base_capacity(SlotSize));
+            for (size_t i = 1; i < ENTRY_COUNT; i++) {
+                capacities[i] = clamp(Sizing::get_next_capacity(capacities[i - 1], SlotSize));
+            }
+            return capacities;
+        }
+
+        static constexpr std::array<size_t, ENTRY_COUNT + 1> build_prefixes() {
+            std::array<size_t, ENTRY_COUNT + 1> prefixes{};
+            for (size_t i = 0; i < ENTRY_COUNT; i++) {
+                prefixes[i + 1] = prefixes[i] + CAPACITIES[i];
+            }
+            return prefixes;
+        }
+
+        /// @var `CAPACITIES`
+        /// @brief The capacity of every block in the table
+        static constexpr std::array<size_t, ENTRY_COUNT> CAPACITIES = build_capacities();
+
+        /// @var `PREFIXES`
+        /// @brief `PREFIXES[i]` is the total capacity of the first `i` blocks
+        static constexpr std::array<size_t, ENTRY_COUNT + 1> PREFIXES = build_prefixes();
+
+        /// @var `LAST_CAPACITY`
+        /// @brief The capacity of the last table entry, which is also the capacity of every block after the table
+        static constexpr size_t LAST_CAPACITY = CAPACITIES[ENTRY_COUNT - 1];
+
+        /// @var `BUCKET_BITS`
+        /// @brief The number of bits below the highest set bit of a slot count which select its bucket, see `get_bucket`
+        static constexpr size_t BUCKET_BITS = 3;
+
+        /// @function `get_bucket`
+        /// @brief Returns the bucket of the given slot count, made of the position of its highest set bit and the `BUCKET_BITS` bits below
+        /// it, like the exponent and the mantissa of a small float. Buckets grow with the slot count, and the largest slot count of a
+        /// bucket is at most `1 + 1 / 2^BUCKET_BITS` times the smallest one, so only very few blocks start inside of a single bucket
+        ///
+        /// @param `n` The slot count, which has to be at least 1
+        /// @return `size_t` The bucket of the slot count
+        static constexpr size_t get_bucket(const size_t n) {
+            const size_t b = 63 - __builtin_clzll(n);
+            const size_t mantissa = b >= BUCKET_BITS ? n >> (b - BUCKET_BITS) : n << (BUCKET_BITS - b);
+            return (b << BUCKET_BITS) | (mantissa & ((size_t(1) << BUCKET_BITS) - 1));
+        }
+
+        static constexpr std::array<uint16_t, (64 << BUCKET_BITS)> build_bucket_starts() {
+            // `BUCKET_STARTS[k]` is the number of blocks needed to hold the smallest slot count of bucket `k` (if it lies inside of the
+            // table). As every block inside of the table is at least as large as the one before it, the slot counts which need more
+            // blocks than the smallest one of their bucket are found in a step or two from there
+            std::array<uint16_t, (64 << BUCKET_BITS)> starts{};
+            size_t count = 0;
+            for (size_t k = 0; k < starts.size(); k++) {
+                const size_t b = k >> BUCKET_BITS;
+                const size_t mantissa = (size_t(1) << BUCKET_BITS) | (k & ((size_t(1) << BUCKET_BITS) - 1));
+                const size_t target = b >= BUCKET_BITS ? mantissa << (b - BUCKET_BITS)
+                                                       : (mantissa + (size_t(1) << (BUCKET_BITS - b)) - 1) >> (BUCKET_BITS - b);
+                while (count < ENTRY_COUNT && PREFIXES[count] < target) {
+                    count++;
+                }
+                starts[k] = count;
+            }
+            return starts;
+        }
+
+        /// @var `BUCKET_STARTS`
+        /// @brief The block counts needed to hold the smallest slot count of every bucket, used to look up the block count of any number of
+        /// slots without searching through the whole table
+        static constexpr std::array<uint16_t, (64 << BUCKET_BITS)> BUCKET_STARTS = build_bucket_starts();
+
+      public:
+        /// @function `get_capacity`
+        /// @brief Returns the capacity of the block at the given index
+        ///
+        /// @param `index` The index of the block
+        /// @return `size_t` The capacity of the block at the given index
+        static constexpr size_t get_capacity(const size_t index) {
+            return index < ENTRY_COUNT ? CAPACITIES[index] : LAST_CAPACITY;
+        }
+
+        /// @function `get_total_capacity`
+        /// @brief Returns the total capacity of the first `count` blocks
+        ///
+        /// @param `count` The number of blocks
+        /// @return `size_t` The summed capacity of the blocks `[0, count)`
+        static constexpr size_t get_total_capacity(const size_t count) {
+            return count <= ENTRY_COUNT ? PREFIXES[count] : PREFIXES[ENTRY_COUNT] + (count - ENTRY_COUNT) * LAST_CAPACITY;
+        }
+
+        /// @function `get_block_count`
+        /// @brief Returns how many blocks (starting from the first one) are needed to hold at least `n` slots
+        ///
+        /// @param `n` The number of slots
+        /// @return `size_t` The smallest block count whose total capacity is at least `n`
+        static constexpr size_t get_block_count(const size_t n) {
+            if (n == 0) {
+                return 0;
+            }
+            if (n > PREFIXES[ENTRY_COUNT]) {
+                return ENTRY_COUNT + (n - PREFIXES[ENTRY_COUNT] + LAST_CAPACITY - 1) / LAST_CAPACITY;
+            }
+            size_t count = BUCKET_STARTS[get_bucket(n)];
+            while (PREFIXES[count] < n) {
+                count++;
+            }
+            return count;
+        }
+
+        /// @function `get_first_fitting_block`
+        /// @brief Returns the index of the first block at or after `from` which has a capacity of at least `capacity`
+        ///
+        /// @param `from` The index of the first block to consider
+        /// @param `capacity` The capacity the block needs to have
+        /// @return `size_t` The index of the first fitting block, `SIZE_MAX` if no block of this curve is large enough
+        static constexpr size_t get_first_fitting_block(const size_t from, const size_t capacity) {
+            if (capacity > LAST_CAPACITY) {
+                return SIZE_MAX;
+            }
+            size_t index = from;
+            while (get_capacity(index) < capacity) {
+                index++;
+            }
+            return index;
+        }
+    };
+} // namespace dima
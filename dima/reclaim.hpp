@@ -0,0 +1,152 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// @namespace `dima`
+/// @brief The `dima` namespace contains all classes used for the DIMA memory management system
+namespace dima {
+
+    /// @class `Reclamation`
+    /// @brief The queues of values whose last reference has been released but which have not been destroyed yet, see
+    /// `default_policy::deferred_reclamation`. Every thread has its own queue holding the values whose last reference it released, and it
+    /// destroys them through `reclaim` whenever it has the time to. Destroying a value may release the last references of further values,
+    /// which end up in the same queue, so even the teardown of a large graph of values is spread across as many calls as it needs. The
+    /// queue is a stack, so the values a destroyed value referred to are the next ones to go while they are still warm in the cache
+    class Reclamation {
+      public:
+        /// @brief The function which destroys a queued value and hands its slot back to its owner. It returns whether that emptied the
+        /// block of the slot, as giving a block back can take much longer than destroying a value
+        using Reclaim = bool (*)(void *slot);
+
+        /// @function `defer`
+        /// @brief Queues the given slot on the calling thread
+        ///
+        /// @param `slot` The slot whose value is destroyed later
+        /// @param `reclaim` The function which destroys the value
+        /// @return `bool` Whether the slot was queued, false if the calling thread is exiting already and has to destroy the value itself
+        static bool defer(void *slot, Reclaim reclaim) {
+            Queue *queue = current_queue;
+            if (queue == nullptr) {
+                if (exited) {
+                    return false;
+                }
+                queue = enter();
+            }
+            queue->pending.push_back({slot, reclaim});
+            return true;
+        }
+
+        /// @function `reclaim`
+        /// @brief Destroys the values queued on the calling thread until the queue is empty, the deadline has passed or `max_values`
+        /// values have been destroyed, whatever comes first. The clock is looked at every few values and after every value whose slot
+        /// emptied its block, so a step goes over its deadline by at most a few values or a single block teardown
+        ///
+        /// @param `deadline` The point in time after which no further value is destroyed
+        /// @param `max_values` The number of values this step may destroy at most
+        /// @return `size_t` The number of destroyed values
+        static size_t reclaim(const std::chrono::steady_clock::time_point deadline, const size_t max_values) {
+            Queue *queue = current_queue;
+            if (queue == nullptr) {
+                return 0;
+            }
+            size_t count = 0;
+            while (count < max_values && !queue->pending.empty()) {
+                const Pending entry = queue->pending.back();
+                queue->pending.pop_back();
+                const bool emptied_block = entry.reclaim(entry.slot);
+                count++;
+                if ((emptied_block || count % RECLAIM_CHECK_INTERVAL == 0) && std::chrono::steady_clock::now() >= deadline) {
+                    break;
+                }
+            }
+            return count;
+        }
+
+        /// @function `get_pending_count`
+        /// @brief Returns the number of values queued on the calling thread
+        ///
+        /// @return `size_t` The number of values waiting to be destroyed
+        static inline size_t get_pending_count() {
+            const Queue *queue = current_queue;
+            return queue != nullptr ? queue->pending.size() : 0;
+        }
+
+      private:
+        /// @var `RECLAIM_CHECK_INTERVAL`
+        /// @brief The number of values `reclaim` destroys between two looks at the clock
+        static constexpr size_t RECLAIM_CHECK_INTERVAL = 8;
+
+        /// @struct `Pending`
+        /// @brief A value waiting to be destroyed
+        struct Pending {
+            void *slot;
+            Reclaim reclaim;
+        };
+
+        /// @struct `Queue`
+        /// @brief The values waiting to be destroyed on a single thread
+        struct Queue {
+            std::vector<Pending> pending;
+        };
+
+        /// @struct `Exit`
+        /// @brief Destroys everything still queued when its thread ends. Values released after that are destroyed right away by the
+        /// releasing thread
+        struct Exit {
+            ~Exit() {
+                Queue *queue = current_queue;
+                while (!queue->pending.empty()) {
+                    const Pending entry = queue->pending.back();
+                    queue->pending.pop_back();
+                    entry.reclaim(entry.slot);
+                }
+                current_queue = nullptr;
+                exited = true;
+                delete queue;
+            }
+        };
+
+        /// @var `current_queue`
+        /// @brief The queue of the calling thread, nullptr until the thread queued its first value and after it has exited. It is a trivial
+        /// thread local, so it stays readable while the other thread locals of the thread are being destroyed
+        static inline thread_local Queue *current_queue = nullptr;
+
+        /// @var `exited`
+        /// @brief Whether the queue of the calling thread has been destroyed already
+        static inline thread_local bool exited = false;
+
+        /// @function `enter`
+        /// @brief Creates the queue of the calling thread
+        ///
+        /// @return `Queue *` The queue of the calling thread
+        static Queue *enter() {
+            current_queue = new Queue();
+            thread_local Exit exit;
+            return current_queue;
+        }
+    };
+
+    /// @function `reclaim`
+    /// @brief Destroys values of types with `deferred_reclamation` whose last reference was released on the calling thread, until none
+    /// is left, the time budget is used up or `max_values` values have been destroyed, see `Reclamation`
+    ///
+    /// @param `budget` The time this step may take at most
+    /// @param `max_values` The number of values this step may destroy at most
+    /// @return `size_t` The number of destroyed values
+    inline size_t reclaim(const std::chrono::microseconds budget, const size_t max_values = SIZE_MAX) {
+        return Reclamation::reclaim(std::chrono::steady_clock::now() + budget, max_values);
+    }
+
+    /// @function `reclaim`
+    /// @brief Destroys at most `max_values` values of types with `deferred_reclamation` whose last reference was released on the calling
+    /// thread, without any time budget
+    ///
+    /// @param `max_values` The number of values this step may destroy at most
+    /// @return `size_t` The number of destroyed values
+    inline size_t reclaim(const size_t max_values) {
+        return Reclamation::reclaim(std::chrono::steady_clock::time_point::max(), max_values);
+    }
+} // namespace dima
@@ -1,29 +1,220 @@
 #pragma once
 
+#include "bias.hpp"
+#include "policy.hpp"
+#include "reclaim.hpp"
+
 #include <atomic>
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
-#include <functional>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
 #include <type_traits>
 
 /// @namespace `dima`
 /// @brief The `dima` namespace contains all classes used for the DIMA memory management system
 namespace dima {
-    static constexpr size_t BASE_SIZE = 16;
+
+    template <typename T, typename> class Slot;
+    template <typename T, typename> class Var;
+
+    /// @class `SlotOwner`
+    /// @brief The interface of everything which owns slots (the blocks). A slot finds its owner through the `SlotArray` it lives in, so no
+    /// slot needs to store a callback or a pointer to its owner
+    template <typename T> class SlotOwner {
+      public:
+        /// @function `slot_freed`
+        /// @brief This function gets called from a slot that has been freed
+        ///
+        /// @param `freed_slot` The slot which has been freed
+        /// @return `bool` Whether handing the slot back emptied the owner, which may have been destroyed by it
+        virtual bool slot_freed(Slot<T, void> *freed_slot) = 0;
+
+        /// @function `slot_pinned`
+        /// @brief This function gets called from a slot of a compactable type which has been pinned or unpinned
+        ///
+        /// @param `pinned_slot` The slot which has been pinned or unpinned
+        /// @param `pinned` Whether the slot is pinned now
+        virtual void slot_pinned([[maybe_unused]] Slot<T, void> *pinned_slot, [[maybe_unused]] const bool pinned) {}
+
+      protected:
+        ~SlotOwner() = default;
+    };
+
+    /// @class `LocalAtomic`
+    /// @brief A stand-in for `std::atomic` with the same interface, for values which are only ever accessed by a single thread. Every
+    /// operation is a plain read or write and all memory orders are ignored, which lets the slots of single threaded types share all of
+    /// their code with the slots of thread safe types
+    template <typename V> class LocalAtomic {
+      public:
+        constexpr LocalAtomic(const V value) :
+            value(value) {}
+
+        inline V load(std::memory_order = std::memory_order_seq_cst) const {
+            return value;
+        }
+
+        inline void store(const V desired, std::memory_order = std::memory_order_seq_cst) {
+            value = desired;
+        }
+
+        inline V fetch_add(const V arg, std::memory_order = std::memory_order_seq_cst) {
+            const V previous = value;
+            value += arg;
+            return previous;
+        }
+
+        inline V fetch_sub(const V arg, std::memory_order = std::memory_order_seq_cst) {
+            const V previous = value;
+            value -= arg;
+            return previous;
+        }
+
+        inline V fetch_or(const V arg, std::memory_order = std::memory_order_seq_cst) {
+            const V previous = value;
+            value |= arg;
+            return previous;
+        }
+
+        inline V fetch_and(const V arg, std::memory_order = std::memory_order_seq_cst) {
+            const V previous = value;
+            value &= arg;
+            return previous;
+        }
+
+        inline bool compare_exchange_weak(V &expected, const V desired, std::memory_order = std::memory_order_seq_cst,
+            std::memory_order = std::memory_order_seq_cst) {
+            if (value != expected) {
+                expected = value;
+                return false;
+            }
+            value = desired;
+            return true;
+        }
+
+      private:
+        V value;
+    };
+
+    /// @struct `FreeLink`
+    /// @brief The links of the intrusive free list of a block. They are stored inside the unused value storage of free slots, which is why
+    /// a free slot never needs any additional memory to be tracked
+    struct FreeLink {
+        uint32_t prev;
+        uint32_t next;
+    };
+
+    /// @union `SlotValue`
+    /// @brief The storage of the value of a slot
+    template <typename T> union SlotValue {
+        /// @var `value`
+        /// @brief The value saved on the slot. As long as the reference count is > 0 this will have a value
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type value;
+
+        /// @var `link`
+        /// @brief The free list links of the slot, only valid while the slot is unused and part of its block's free list
+        FreeLink link;
+    };
+
+    /// @struct `SlotArrayHeader`
+    /// @brief The header which is stored directly in front of the first slot of every `SlotArray`
+    template <typename T> struct SlotArrayHeader {
+        /// @var `owner`
+        /// @brief The owner of all slots of the array
+        SlotOwner<T> *owner;
+
+        /// @var `values`
+        /// @brief The values of all slots of the array if they use the split layout, nullptr otherwise
+        SlotValue<T> *values;
+    };
+
+    /// @struct `SlotPayload`
+    /// @brief The part of a slot which holds its value. With the interleaved layout every slot holds its own value, with the split layout
+    /// the slot holds nothing and its value lives in the value array of its `SlotArray` instead
+    template <typename T, bool Split> struct SlotPayload {
+        SlotValue<T> payload;
+    };
+
+    template <typename T> struct SlotPayload<T, true> {};
+
+    /// @struct `SlotReferences`
+    /// @brief The list of all variables referring to a slot, which only the slots of compactable types keep (see `incremental_compaction`).
+    /// It is what lets a value move to another slot, as every variable of the list can be redirected to the new slot
+    template <typename T, bool Tracked> struct SlotReferences {
+        /// @var `references`
+        /// @brief The first variable of the list of variables referring to this slot, linked through the variables themselves
+        Var<T, void> *references = nullptr;
+    };
+
+    template <typename T> struct SlotReferences<T, false> {};
+
+    /// @struct `SlotBias`
+    /// @brief The owner thread and its local reference count, which only the slots of biased types keep (see
+    /// `default_policy::biased_references`)
+    template <bool Biased> struct SlotBias {
+        /// @var `owner_thread`
+        /// @brief The id of the thread whose references are counted in `local_count`, `BiasedThreads::NO_THREAD` once the local count
+        /// has been merged into the shared count of the header
+        std::atomic<uint32_t> owner_thread = {BiasedThreads::NO_THREAD};
+
+        /// @var `local_count`
+        /// @brief The number of references counted by the owner thread, which is the only thread ever changing it
+        uint32_t local_count = 0;
+    };
+
+    template <> struct SlotBias<false> {};
+
+    /// @struct `SlotGeneration`
+    /// @brief The generation of a slot, which only the slots of types with weak references keep (see `default_policy::weak_references`)
+    template <bool Weak, bool Atomic> struct SlotGeneration {
+        /// @var `generation`
+        /// @brief The number of values which have been destroyed in this slot, it only changes while the slot is unused
+        std::conditional_t<Atomic, std::atomic<uint32_t>, LocalAtomic<uint32_t>> generation = {0};
+    };
+
+    template <bool Atomic> struct SlotGeneration<false, Atomic> {};
 
     /// @class `Slot`
     /// @brief A slot inside a DIMA block, the slot is the smallest possible value of DIMA, and it only contains a value and the arc counter
     template <typename T, typename = std::enable_if_t<std::is_class_v<T>>> //
-    class Slot {
+    class Slot : public SlotPayload<T, slot_layout<T>::split>,
+                 public SlotReferences<T, slot_compaction<T>::enabled>,
+                 public SlotBias<type_policy<T>::type::biased_references>,
+                 public SlotGeneration<type_policy<T>::type::weak_references, type_policy<T>::type::thread_safe> {
       public:
-        Slot() :
-            value_ptr(reinterpret_cast<T *>(&value)) {}
-        Slot(void *owner_ptr) :
-            value_ptr(value_ptr = reinterpret_cast<T *>(&value)) {
-            // Only overwride the owner if this slot does not have an owner
-            if (this->owner_ptr == nullptr) {
-                this->owner_ptr = owner_ptr;
-            }
-        }
+        explicit Slot(const uint32_t index) :
+            index(index) {}
+
+        /// @var `SPLIT`
+        /// @brief Whether the value of this slot is stored apart from the slot, see `split_layout`
+        static constexpr bool SPLIT = slot_layout<T>::split;
+
+        /// @var `TRACKED`
+        /// @brief Whether this slot keeps track of all variables referring to it, so its value can be moved, see `incremental_compaction`
+        static constexpr bool TRACKED = slot_compaction<T>::enabled;
+
+        /// @var `ATOMIC`
+        /// @brief Whether the header of this slot is an atomic, which it is unless the type is single threaded, see
+        /// `default_policy::thread_safe`
+        static constexpr bool ATOMIC = type_policy<T>::type::thread_safe;
+
+        /// @var `BIASED`
+        /// @brief Whether the references of the thread which allocated the value of this slot are counted apart from all other references,
+        /// see `default_policy::biased_references`
+        static constexpr bool BIASED = type_policy<T>::type::biased_references;
+
+        /// @var `WEAK`
+        /// @brief Whether this slot keeps a generation for the weak variables referring to it, see `default_policy::weak_references`
+        static constexpr bool WEAK = type_policy<T>::type::weak_references;
+
+        /// @var `DEFERRED`
+        /// @brief Whether the value of this slot is destroyed later through `dima::reclaim` instead of by its last release, see
+        /// `default_policy::deferred_reclamation`
+        static constexpr bool DEFERRED = type_policy<T>::type::deferred_reclamation;
+
+        static_assert(ATOMIC || !BIASED, "Biased reference counting is only needed by thread safe types");
 
         enum SlotFlags : uint8_t {
             UNUSED = 0, // It's unused when the flags are completely empty
@@ -33,74 +224,207 @@ namespace dima {
             ARRAY_MEMBER = 8,
             ASYNC = 16,
             OWNED_BY_ENTITY = 32,
+            PINNED = 64,
+            MERGED = 128, // All references of a biased slot are counted in the header
         };
 
-        /// @var `flags`
-        /// @brief The flags of this slot
-        uint8_t flags = UNUSED;
-
-        /// @var `arc`
-        /// @brief The reference counter of this slot, to track how many variables are using this slot
-        /// @note The ARC is a 24 Bit number in Flint but C++ does not have a 24 bit number natively so we use the next larger number, being
-        /// 32 Bit in size
-        std::atomic<uint32_t> arc = {0};
+        /// @var `ARC_MASK`
+        /// @brief The bits of the `header` which hold the reference count, the ARC is a 24 Bit number just like in Flint
+        static constexpr uint32_t ARC_MASK = 0x00FFFFFF;
 
-        /// @var `owner_ptr`
-        /// @brief The pointer to the owner of this slot
-        /// @note A slot can be without an owner, this is intentional and important for the defragmentation process
-        void *owner_ptr = nullptr;
+        /// @var `FLAGS_SHIFT`
+        /// @brief The position of the 8 flag bits inside of the `header`
+        static constexpr uint32_t FLAGS_SHIFT = 24;
 
-        /// @var `value`
-        /// @brief The value saved on this slot. As long as the reference count is > 0 this will have a value
-        typename std::aligned_storage<sizeof(T), alignof(T)>::type value;
-
-        /// @var `value_ptr`
-        /// @brief This value pointer is created when the slot is created and it never changes. It only exists to make the `get` function
-        /// faster, as there does not need to happen a reinterpret_cast for every single call of `get`
-        T *value_ptr;
+        /// @var `header`
+        /// @brief The reference counter of this slot (for biased slots the shared count, the lower 24 bits) and the `SlotFlags` of this
+        /// slot (the upper 8 bits) in a single atomic word, so retaining, releasing and marking this slot as free are each a single atomic
+        /// operation. For single threaded types it is a plain integer
+        std::conditional_t<ATOMIC, std::atomic<uint32_t>, LocalAtomic<uint32_t>> header = {0};
 
-        /// @var `on_free_callback`
-        /// @brief The callback function which gets executed when this slot becomes empty (`arc` becomes 0)
-        std::function<void(Slot<T> *)> on_free_callback;
+        /// @var `index`
+        /// @brief The index of this slot inside of its `SlotArray`, which is all a slot needs to find its owner
+        const uint32_t index;
 
         /// @function `allocate`
         /// @brief Sets the value of this slot to a new value of type `T`, emplaces the created value of type `T` directly in the value
         ///
         /// @param `args` The arguments with which to create the value of type `T`
         template <typename... Args> void allocate(Args &&...args) {
-            new (&value) T(std::forward<Args>(args)...);
-            flags |= OCCUPIED;
-            arc = 1;
+            new (&get_value().value) T(std::forward<Args>(args)...);
+            publish();
+        }
+
+        /// @function `allocate_from`
+        /// @brief Sets the value of this slot to the result of the given factory. A factory returning a `T` constructs it directly in this
+        /// slot, without any move
+        ///
+        /// @param `factory` The function whose result the value of type `T` is created from
+        template <typename Factory> void allocate_from(Factory &&factory) {
+            new (&get_value().value) T(factory());
+            publish();
+        }
+
+        /// @function `mark_array_element`
+        /// @brief Marks the freshly allocated value of this slot as an element of an array. An `Array` refers to its elements through raw
+        /// slot pointers, so compaction never moves a marked value
+        ///
+        /// @param `start` Whether this slot holds the first element of the array
+        inline void mark_array_element(const bool start) {
+            header.fetch_or(uint32_t(start ? ARRAY_START : ARRAY_MEMBER) << FLAGS_SHIFT, std::memory_order_relaxed);
+        }
+
+        /// @function `discard`
+        /// @brief Destroys the value of a freshly allocated slot again before any other variable could see it, which undoes `allocate`. The
+        /// slot is left unused, but it is not handed back to its owner and does not move on to its next generation
+        void discard() {
+            get()->~T();
+            header.store(UNUSED, std::memory_order_relaxed);
         }
 
         /// @function `retain`
-        /// @brief This function is called whenever a new variable gets access to this slot
+        /// @brief This function is called whenever a new variable gets access to this slot. The caller already holds a reference, so the
+        /// slot is occupied and the increment does not need to be ordered with anything. The owner thread of a biased slot only increments
+        /// its local count, without any atomic operation. A value can have at most `ARC_MASK` references, the increment is a compare and
+        /// swap which never writes a count beyond that into the header, as the carry would change the flags for every other thread, and
+        /// `std::overflow_error` is thrown instead
         void retain() {
-            if (is_occupied()) {
-                ++arc;
+            if constexpr (BIASED) {
+                if (this->owner_thread.load(std::memory_order_relaxed) == BiasedThreads::get_current()) {
+                    if (this->local_count == ARC_MASK) {
+                        throw_overflow();
+                    }
+                    this->local_count++;
+                    return;
+                }
             }
+            uint32_t current = header.load(std::memory_order_relaxed);
+            do {
+                assert(BIASED || (current & ARC_MASK) != 0);
+                if ((current & ARC_MASK) == ARC_MASK) {
+                    throw_overflow();
+                }
+            } while (!header.compare_exchange_weak(current, current + 1, std::memory_order_relaxed, std::memory_order_relaxed));
         }
 
         /// @function `release`
         /// @brief This function is called whenever a variable goes out of scope or is freed in other ways. It reduces the arc and calls the
-        /// callback function if this slot becomes empty to let the block this slot is in know that it has been freed
+        /// callback function if this slot becomes empty to let the block this slot is in know that it has been freed. The last reference
+        /// clears the flags in the same atomic operation which drops the count to zero, so no other thread can ever see an unused slot
+        /// that still looks occupied
         void release() {
-            if (is_occupied() && --arc == 0) {
-                get()->~T();
-                flags = UNUSED;
-                if (on_free_callback) {
-                    // Notify that this slot was freed
-                    on_free_callback(this);
+            if (drop()) {
+                // Notify the owner that this slot was freed
+                get_owner()->slot_freed(this);
+            }
+        }
+
+        /// @function `drop`
+        /// @brief Releases a reference like `release` and destroys the value if it was the last one, but leaves handing this slot back to
+        /// its owner to the caller, which lets many freed slots be handed back to their blocks at once. The value of a slot with deferred
+        /// reclamation is queued instead, and this slot is handed back once it has been destroyed through `dima::reclaim`
+        ///
+        /// @return `bool` Whether the value has been destroyed, in that case the caller has to hand this slot back to its owner
+        bool drop() {
+            if constexpr (BIASED) {
+                return release_biased();
+            }
+            uint32_t current = header.load(std::memory_order_relaxed);
+            uint32_t next;
+            do {
+                assert((current & ARC_MASK) != 0);
+                next = (current & ARC_MASK) == 1 ? uint32_t(UNUSED) : current - 1;
+            } while (!header.compare_exchange_weak(current, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+            if (next == UNUSED) {
+                return retire(current);
+            }
+            return false;
+        }
+
+        /// @function `try_retain`
+        /// @brief Retains this slot only if it still holds a value. This is how a weak variable, which holds no reference itself, gets a
+        /// reference to the value. The caller has to make sure the block of this slot is not destroyed meanwhile, and the value may be a
+        /// newer one than the caller expects, so the generation has to be checked again once the reference is held
+        ///
+        /// @return `bool` Whether this slot held a value and has been retained
+        bool try_retain() {
+            uint32_t current = header.load(std::memory_order_relaxed);
+            do {
+                if ((current >> FLAGS_SHIFT) == UNUSED) {
+                    return false;
+                }
+                if ((current & ARC_MASK) == ARC_MASK) {
+                    throw_overflow();
+                }
+            } while (!header.compare_exchange_weak(current, current + 1, std::memory_order_acquire, std::memory_order_relaxed));
+            return true;
+        }
+
+        /// @function `get_generation`
+        /// @brief Returns the generation of this slot, see `SlotGeneration`
+        ///
+        /// @return `uint32_t` The generation of this slot
+        inline uint32_t get_generation() const {
+            static_assert(WEAK, "Only the slots of types with weak references keep a generation");
+            return this->generation.load(std::memory_order_acquire);
+        }
+
+        /// @function `pin`
+        /// @brief Pins the value of this slot to its place, so compaction never moves it. This is needed whenever raw pointers to the value
+        /// outlive the call which obtained them. Pinning only has an effect for compactable types
+        void pin() {
+            if constexpr (TRACKED) {
+                const uint32_t previous = header.fetch_or(uint32_t(PINNED) << FLAGS_SHIFT, std::memory_order_relaxed);
+                if (!((previous >> FLAGS_SHIFT) & PINNED)) {
+                    get_owner()->slot_pinned(this, true);
+                }
+            }
+        }
+
+        /// @function `unpin`
+        /// @brief Lets compaction move the value of this slot again
+        void unpin() {
+            if constexpr (TRACKED) {
+                const uint32_t previous = header.fetch_and(~(uint32_t(PINNED) << FLAGS_SHIFT), std::memory_order_relaxed);
+                if ((previous >> FLAGS_SHIFT) & PINNED) {
+                    get_owner()->slot_pinned(this, false);
                 }
             }
         }
 
+        /// @function `relocate`
+        /// @brief Moves the value of this slot into the given reserved slot through the move constructor of `T` and redirects all variables
+        /// referring to this slot to the target. The target takes over the reference count and the flags of this slot, while this slot
+        /// is left unused and has to be handed back to its owner by the caller. Nothing may access the value while it moves
+        ///
+        /// @param `target` The reserved slot to move the value into
+        void relocate(Slot<T> *target) {
+            static_assert(TRACKED, "Only the values of compactable types can be relocated");
+            new (&target->get_value().value) T(std::move(*get()));
+            get()->~T();
+            for (Var<T, void> *var = this->references; var != nullptr; var = var->next_reference) {
+                var->slot = target;
+            }
+            target->references = this->references;
+            this->references = nullptr;
+            if constexpr (BIASED) {
+                target->owner_thread.store(this->owner_thread.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                target->local_count = this->local_count;
+            }
+            target->header.store(header.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            header.store(UNUSED, std::memory_order_relaxed);
+            if constexpr (WEAK) {
+                // Weak variables cannot be redirected, the moved value is a new one for them
+                next_generation();
+            }
+        }
+
         /// @function `is_occupied`
         /// @brief Checks whether this slot is occupied with any value
         ///
         /// @return `bool` Whether this slot is occupied with any value
         inline bool is_occupied() const {
-            return flags != 0;
+            return get_flags() != UNUSED;
         }
 
         /// @function `is_array_start`
@@ -108,7 +432,15 @@ namespace dima {
         ///
         /// @return `bool` Whether this slot is the start of an array
         inline bool is_array_start() const {
-            return flags & ARRAY_START;
+            return get_flags() & ARRAY_START;
+        }
+
+        /// @function `is_pinned`
+        /// @brief Checks whether this slot is pinned, see `pin`
+        ///
+        /// @return `bool` Whether this slot is pinned
+        inline bool is_pinned() const {
+            return get_flags() & PINNED;
         }
 
         /// @function `is_array_member`
@@ -116,7 +448,30 @@ namespace dima {
         ///
         /// @return `bool` Whether this slot is a member of an array
         inline bool is_array_member() const {
-            return flags & ARRAY_MEMBER;
+            return get_flags() & ARRAY_MEMBER;
+        }
+
+        /// @function `get_flags`
+        /// @brief Returns the flags of this slot
+        ///
+        /// @return `uint8_t` The `SlotFlags` of this slot
+        inline uint8_t get_flags() const {
+            return header.load(std::memory_order_acquire) >> FLAGS_SHIFT;
+        }
+
+        /// @function `get_arc`
+        /// @brief Returns the reference count of this slot. Under concurrent use this is only a snapshot
+        ///
+        /// @return `uint32_t` The reference count of this slot
+        inline uint32_t get_arc() const {
+            const uint32_t shared = header.load(std::memory_order_relaxed) & ARC_MASK;
+            if constexpr (BIASED) {
+                // The local count may only be read by the owner thread, so other threads only see the shared count
+                if (this->owner_thread.load(std::memory_order_relaxed) == BiasedThreads::get_current()) {
+                    return shared + this->local_count;
+                }
+            }
+            return shared;
         }
 
         /// @function `get`
@@ -127,7 +482,303 @@ namespace dima {
         ///
         /// @return `T *` Returns the value saved on this slot direclty
         inline T *get() {
-            return value_ptr;
+            return std::launder(reinterpret_cast<T *>(&get_value().value));
+        }
+
+        /// @function `get_link`
+        /// @brief Returns the free list links of this slot, which share their storage with the value of this slot
+        ///
+        /// @return `FreeLink &` The free list links of this slot
+        inline FreeLink &get_link() {
+            return get_value().link;
+        }
+
+        /// @function `get_owner`
+        /// @brief Returns the owner of this slot, which is stored in the header directly in front of the first slot of the `SlotArray`
+        ///
+        /// @return `SlotOwner<T> *` The owner of this slot
+        inline SlotOwner<T> *get_owner() {
+            return get_array_header()->owner;
+        }
+
+      private:
+        /// @function `publish`
+        /// @brief Marks the freshly constructed value of this slot as occupied and gives it its first reference
+        inline void publish() {
+            if constexpr (BIASED) {
+                // The first reference belongs to the allocating thread, which becomes the owner of this slot
+                this->owner_thread.store(BiasedThreads::get_current(), std::memory_order_relaxed);
+                this->local_count = 1;
+                header.store(uint32_t(OCCUPIED) << FLAGS_SHIFT, std::memory_order_release);
+                return;
+            }
+            // Publishes the constructed value together with the first reference
+            header.store((uint32_t(OCCUPIED) << FLAGS_SHIFT) | 1, std::memory_order_release);
         }
+
+        /// @function `retire`
+        /// @brief Gets rid of the value of this slot after its last reference has been released. The value is destroyed right away, unless
+        /// this slot has deferred reclamation, then it is queued through `Reclamation::defer` and stays in this slot until it is
+        /// reclaimed. Until then the header of this slot already reads unused, so weak variables cannot upgrade to the value anymore,
+        /// but the slot is still reserved in its block, which keeps the block alive
+        ///
+        /// @param `last` The header of this slot right before the last reference was released
+        /// @return `bool` Whether the value has been destroyed, in that case the caller has to hand this slot back to its owner
+        bool retire(const uint32_t last) {
+            if constexpr (TRACKED) {
+                if ((last >> FLAGS_SHIFT) & PINNED) {
+                    get_owner()->slot_pinned(this, false);
+                }
+            }
+            if constexpr (DEFERRED) {
+                if (Reclamation::defer(this, &reclaim_deferred)) {
+                    return false;
+                }
+            }
+            destroy_value();
+            return true;
+        }
+
+        /// @function `destroy_value`
+        /// @brief Destroys the value of this slot after its last reference has been released
+        void destroy_value() {
+            get()->~T();
+            if constexpr (WEAK) {
+                next_generation();
+            }
+        }
+
+        /// @function `next_generation`
+        /// @brief Moves this slot to its next generation once its value is gone, so no weak variable of the old value accepts the next
+        /// value of this slot. It happens before the slot is handed back, so whoever retains the next value also sees the new generation
+        inline void next_generation() {
+            this->generation.store(this->generation.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /// @function `release_biased`
+        /// @brief Releases a reference of a biased slot. The owner thread only decrements its local count, and once that drops to zero
+        /// the local count is merged into the shared count. Every other thread decrements the shared count, but a reference counted by the
+        /// owner (the shared count is zero while the local count is not merged yet) can only be dropped by the owner, so it is handed over
+        /// to the owner thread through `BiasedThreads::defer`
+        ///
+        /// @return `bool` Whether the value has been destroyed, in that case the caller has to hand this slot back to its owner
+        bool release_biased() {
+            if (this->owner_thread.load(std::memory_order_relaxed) == BiasedThreads::get_current()) {
+                if (--this->local_count > 0) {
+                    return false;
+                }
+                // From now on all references are counted in the shared count
+                this->owner_thread.store(BiasedThreads::NO_THREAD, std::memory_order_relaxed);
+                uint32_t current = header.load(std::memory_order_relaxed);
+                uint32_t next;
+                do {
+                    next = (current & ARC_MASK) == 0 ? uint32_t(UNUSED) : current | (uint32_t(MERGED) << FLAGS_SHIFT);
+                } while (!header.compare_exchange_weak(current, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+                if (next == UNUSED) {
+                    return retire(current);
+                }
+                return false;
+            }
+            uint32_t current = header.load(std::memory_order_relaxed);
+            while (((current >> FLAGS_SHIFT) & MERGED) || (current & ARC_MASK) != 0) {
+                const bool merged = (current >> FLAGS_SHIFT) & MERGED;
+                const uint32_t next = merged && (current & ARC_MASK) == 1 ? uint32_t(UNUSED) : current - 1;
+                if (header.compare_exchange_weak(current, next, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                    if (next == UNUSED) {
+                        return retire(current);
+                    }
+                    return false;
+                }
+            }
+            if (!BiasedThreads::defer(this->owner_thread.load(std::memory_order_relaxed), this, &release_deferred)) {
+                // The owner thread has exited, so its local count cannot change anymore and is merged right here
+                merge_local_count();
+                return release_biased();
+            }
+            return false;
+        }
+
+        /// @function `release_deferred`
+        /// @brief Drops a reference which was handed over to the owner thread, on the owner thread
+        ///
+        /// @param `slot` The slot whose reference is dropped
+        static void release_deferred(void *slot) {
+            Slot *biased_slot = static_cast<Slot *>(slot);
+            biased_slot->merge_local_count();
+            if (biased_slot->release_biased()) {
+                biased_slot->get_owner()->slot_freed(biased_slot);
+            }
+        }
+
+        /// @function `reclaim_deferred`
+        /// @brief Destroys a value queued by `retire` and hands its slot back to its owner, on the thread which released the value
+        ///
+        /// @param `slot` The slot whose value is destroyed
+        /// @return `bool` Whether handing the slot back emptied its block
+        static bool reclaim_deferred(void *slot) {
+            Slot *deferred_slot = static_cast<Slot *>(slot);
+            deferred_slot->destroy_value();
+            return deferred_slot->get_owner()->slot_freed(deferred_slot);
+        }
+
+        /// @function `merge_local_count`
+        /// @brief Merges the local count of the owner thread into the shared count. This may only run on the owner thread or after the
+        /// owner thread has exited, and the caller has to hold a reference, so the merged count is never zero. Both counts are checked
+        /// against `ARC_MASK` on their own, so only their sum can be too large here. As this happens while a reference is released, where
+        /// nothing can be thrown, the program is aborted instead of corrupting the flags
+        void merge_local_count() {
+            uint32_t current = header.load(std::memory_order_relaxed);
+            do {
+                if ((current >> FLAGS_SHIFT) & MERGED) {
+                    return;
+                }
+                if ((current & ARC_MASK) + uint64_t(this->local_count) > ARC_MASK) {
+                    std::abort();
+                }
+            } while (!header.compare_exchange_weak(current, (current + this->local_count) | (uint32_t(MERGED) << FLAGS_SHIFT),
+                std::memory_order_acq_rel, std::memory_order_relaxed));
+            this->owner_thread.store(BiasedThreads::NO_THREAD, std::memory_order_relaxed);
+        }
+
+        /// @function `throw_overflow`
+        /// @brief Throws the error of a value which would get more references than its reference count can hold
+        [[noreturn]] static void throw_overflow() {
+            throw std::overflow_error("dima: a value cannot have more than 16777215 references, see Slot::ARC_MASK");
+        }
+
+        /// @function `get_array_header`
+        /// @brief Returns the header of the `SlotArray` this slot lives in
+        inline SlotArrayHeader<T> *get_array_header() {
+            return reinterpret_cast<SlotArrayHeader<T> *>(this - index) - 1;
+        }
+
+        /// @function `get_value`
+        /// @brief Returns the value storage of this slot, which either is a part of this slot or lives in the value array of its
+        /// `SlotArray`
+        inline SlotValue<T> &get_value() {
+            if constexpr (SPLIT) {
+                return get_array_header()->values[index];
+            } else {
+                return this->payload;
+            }
+        }
+    };
+
+    /// @class `SlotArray`
+    /// @brief The slots of a block in a single allocation, with a `SlotArrayHeader` stored directly in front of the first slot. Every slot
+    /// knows its own index, so it finds its owner with pointer arithmetic alone. With the split layout the values of all slots follow the
+    /// slots in the same allocation, starting on a fresh cache line
+    template <typename T> class SlotArray {
+      public:
+        /// @var `SLOT_SIZE`
+        /// @brief The number of bytes every slot of this array takes up, including its value
+        static constexpr size_t SLOT_SIZE = sizeof(Slot<T>) + (Slot<T>::SPLIT ? sizeof(SlotValue<T>) : 0);
+
+        /// @var `VALUES_ALIGNMENT`
+        /// @brief The alignment of the value array of the split layout, which always starts on its own cache line so no value shares a
+        /// cache line with the reference counts of the slots
+        static constexpr size_t VALUES_ALIGNMENT = alignof(SlotValue<T>) > 64 ? alignof(SlotValue<T>) : 64;
+
+        /// @var `ALIGNMENT`
+        /// @brief The alignment of the allocation, which is large enough for the header, the slots and the values
+        static constexpr size_t ALIGNMENT = Slot<T>::SPLIT ? VALUES_ALIGNMENT
+            : (alignof(Slot<T>) > alignof(SlotArrayHeader<T>) ? alignof(Slot<T>) : alignof(SlotArrayHeader<T>));
+
+        /// @var `HEADER_SIZE`
+        /// @brief The number of bytes in front of the first slot, which hold the header
+        static constexpr size_t HEADER_SIZE = (sizeof(SlotArrayHeader<T>) + alignof(Slot<T>) - 1) / alignof(Slot<T>) * alignof(Slot<T>);
+
+        /// @function `get_allocation_size`
+        /// @brief Returns the number of bytes the memory of an array with the given number of slots needs
+        ///
+        /// @param `count` The number of slots
+        /// @return `size_t` The number of bytes needed
+        static constexpr size_t get_allocation_size(const size_t count) {
+            if constexpr (Slot<T>::SPLIT) {
+                return get_values_offset(count) + count * sizeof(SlotValue<T>);
+            } else {
+                return HEADER_SIZE + count * sizeof(Slot<T>);
+            }
+        }
+
+        SlotArray(SlotOwner<T> *owner, const uint32_t count) :
+            SlotArray(owner, count, static_cast<std::byte *>(::operator new(get_allocation_size(count), std::align_val_t(ALIGNMENT)))) {
+            owns_storage = true;
+        }
+
+        /// @brief Creates the array inside of the given memory, which has to be aligned to `ALIGNMENT`, hold `get_allocation_size(count)`
+        /// bytes and outlive the array. This lets a block keep its slots in the same allocation as itself. Only the header is written
+        /// here, the slots themselves are constructed through `init` once their owner hands them out for the first time, so creating an
+        /// array takes constant time and never touches the pages of slots which are not used yet
+        SlotArray(SlotOwner<T> *owner, const uint32_t count, std::byte *memory) :
+            storage(memory),
+            first(reinterpret_cast<Slot<T> *>(storage + HEADER_SIZE)),
+            values(Slot<T>::SPLIT ? reinterpret_cast<SlotValue<T> *>(storage + get_values_offset(count)) : nullptr) {
+            new (reinterpret_cast<SlotArrayHeader<T> *>(first) - 1) SlotArrayHeader<T>{owner, values};
+        }
+
+        SlotArray(const SlotArray &) = delete;
+        SlotArray &operator=(const SlotArray &) = delete;
+
+        ~SlotArray() {
+            // Slots are trivially destructible, the values still living in them are owned by their variables
+            if (owns_storage) {
+                ::operator delete(storage, std::align_val_t(ALIGNMENT));
+            }
+        }
+
+        /// @function `init`
+        /// @brief Constructs the unused slot at the given index, which has to happen before the slot is handed out for the first time.
+        /// Constructing a slot again while it is unused is harmless
+        ///
+        /// @param `idx` The index of the slot to construct
+        /// @return `Slot<T> &` The constructed slot
+        inline Slot<T> &init(const uint32_t idx) {
+            return *new (first + idx) Slot<T>(idx);
+        }
+
+        inline Slot<T> &operator[](const size_t idx) {
+            return first[idx];
+        }
+
+        inline const Slot<T> &operator[](const size_t idx) const {
+            return first[idx];
+        }
+
+        /// @function `get_value`
+        /// @brief Returns the value storage of the slot at the given index, without going through the header like the slot itself has to
+        ///
+        /// @param `idx` The index of the slot
+        /// @return `SlotValue<T> &` The value storage of the slot
+        inline SlotValue<T> &get_value(const size_t idx) {
+            if constexpr (Slot<T>::SPLIT) {
+                return values[idx];
+            } else {
+                return first[idx].payload;
+            }
+        }
+
+      private:
+        /// @function `get_values_offset`
+        /// @brief Returns the offset of the value array of the split layout from the start of the allocation
+        static constexpr size_t get_values_offset(const size_t count) {
+            return (HEADER_SIZE + count * sizeof(Slot<T>) + VALUES_ALIGNMENT - 1) / VALUES_ALIGNMENT * VALUES_ALIGNMENT;
+        }
+
+        /// @var `storage`
+        /// @brief The start of the allocation
+        std::byte *storage;
+
+        /// @var `first`
+        /// @brief The first slot of the array
+        Slot<T> *first;
+
+        /// @var `values`
+        /// @brief The values of all slots if they use the split layout, nullptr otherwise
+        SlotValue<T> *values;
+
+        /// @var `owns_storage`
+        /// @brief Whether this array allocated its memory itself and has to free it again
+        bool owns_storage = false;
     };
 } // namespace dima
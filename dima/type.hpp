@@ -1,15 +1,27 @@
+#pragma once
+
+#include "handle.hpp"
 #include "head.hpp"
+#include "policy.hpp"
 #include "var.hpp"
+#include "weak.hpp"
+
+#include <chrono>
 #include <utility>
+#include <vector>
 
 /// @namespace `dima`
 /// @brief The `dima` namespace contains all classes used for the DIMA memory management system
 namespace dima {
 
     /// @class `Type`
-    /// @brief A base class for all types managed by DIMA
-    template <typename T> class Type {
+    /// @brief A base class for all types managed by DIMA. The `Policy` decides how the DIMA head of this type behaves, for example how its
+    /// blocks grow (see `dima::default_policy`)
+    template <typename T, typename Policy = default_policy> class Type {
       public:
+        /// @brief The policy of this type, which is also how the slots of `T` find their layout
+        using dima_policy = Policy;
+
         /// @function `allocate`
         /// @brief Creates a new variable of type `T` and saves it in one of the blocks
         ///
@@ -19,6 +31,49 @@ namespace dima {
             return head.allocate(std::forward<Args>(args)...);
         }
 
+        /// @function `allocate_bulk`
+        /// @brief Creates `n` independent values of type `T` at once, see `Head::allocate_bulk`
+        ///
+        /// @param `n` The number of values to create
+        /// @param `out` The output iterator every `Var<T>` is written to, in the order of the values
+        /// @param `generate` The function called with the index of every value, whose result the value is created from
+        /// @return `OutputIt` The output iterator behind the last written variable
+        template <typename OutputIt, typename Generator>
+        static inline OutputIt allocate_bulk(const size_t n, OutputIt out, Generator &&generate) {
+            return head.allocate_bulk(n, out, std::forward<Generator>(generate));
+        }
+
+        /// @function `allocate_n`
+        /// @brief Creates `n` independent values of type `T` at once, all constructed from the same arguments, see `Head::allocate_n`
+        ///
+        /// @param `n` The number of values to create
+        /// @param `out` The output iterator every `Var<T>` is written to
+        /// @param `args` The arguments with which every value is created
+        /// @return `OutputIt` The output iterator behind the last written variable
+        template <typename OutputIt, typename... Args>
+        static inline OutputIt allocate_n(const size_t n, OutputIt out, const Args &...args) {
+            return head.allocate_n(n, out, args...);
+        }
+
+        /// @function `release_bulk`
+        /// @brief Releases the references of all variables in the range `[first, last)` at once and leaves the variables null, see
+        /// `Head::release_bulk`
+        ///
+        /// @param `first` The iterator to the first variable
+        /// @param `last` The iterator behind the last variable
+        template <typename Iterator> static inline void release_bulk(Iterator first, Iterator last) {
+            head.release_bulk(first, last);
+        }
+
+        /// @function `release_bulk`
+        /// @brief Releases the references of all variables of the given vector at once and clears the vector
+        ///
+        /// @param `vars` The variables to release
+        static inline void release_bulk(std::vector<Var<T>> &vars) {
+            head.release_bulk(vars.begin(), vars.end());
+            vars.clear();
+        }
+
         /// @function `allocate_array`
         /// @brief Allocates a new array of type `T` with size `length`, where all elements of said array are placed contiguously inside a
         /// single block
@@ -32,7 +87,7 @@ namespace dima {
 
         /// @function `reserve`
         /// @brief Reserves enough space in the DIMA tree that at least `n` objects will fit in it. This function only creates the biggest
-        /// block in the block list, which holds at least `(n / 2) + BASE_SIZE` elements, as block creation and block filling is done from
+        /// block of the block list which the growth curve needs to hold `n` elements, as block creation and block filling is done from
         /// the biggest to the smallest blocks. This reduces fragmentation over time and also improves allocation speed, as the biggest
         /// blocks are the most unlikely to be filled up.
         ///
@@ -41,6 +96,24 @@ namespace dima {
             head.reserve(n);
         }
 
+        /// @function `trim`
+        /// @brief Destroys all empty blocks which are kept alive by the retention policy of this type
+        ///
+        /// @return `size_t` The number of destroyed blocks
+        static inline size_t trim() {
+            return head.trim();
+        }
+
+        /// @function `compact`
+        /// @brief Moves live values of this type out of sparsely occupied blocks into denser ones until the given time budget is used up,
+        /// see `Head::compact`. Only available for types with an `incremental_compaction` policy
+        ///
+        /// @param `budget` The time this step may take at most
+        /// @return `size_t` The number of moved values
+        static inline size_t compact(const std::chrono::microseconds budget) {
+            return head.compact(budget);
+        }
+
         /// @function `get_allocation_count`
         /// @brief Returns the number of all allocated variables of type `T`
         ///
@@ -76,6 +149,10 @@ namespace dima {
       private:
         /// @var `head`
         /// @brief The static DIMA head instance for this type
-        static inline Head<T> head;
+        static inline Head<T, Policy> head;
+
+        template <typename> friend class WeakVar;
+        template <typename> friend class Handle;
+        template <typename> friend class WeakHandle;
     };
 } // namespace dima
@@ -2,12 +2,34 @@
 
 #include "slot.hpp"
 
+#include <cassert>
 #include <type_traits>
 
 /// @namespace `dima`
 /// @brief The `dima` namespace contains all classes used for the DIMA memory management system
 namespace dima {
 
+    /// @struct `VarLinks`
+    /// @brief The links of a variable inside of the list of all variables referring to the same slot, which only the variables of
+    /// compactable types need, see `SlotReferences`
+    template <typename V, bool Tracked> struct VarLinks {
+        /// @var `prev_reference`
+        /// @brief The previous variable referring to the same slot
+        V *prev_reference = nullptr;
+
+        /// @var `next_reference`
+        /// @brief The next variable referring to the same slot
+        V *next_reference = nullptr;
+    };
+
+    template <typename V> struct VarLinks<V, false> {};
+
+    template <typename T> class Ref;
+    template <typename T> class WeakVar;
+    template <typename T> class Handle;
+    template <typename T> class WeakHandle;
+    template <typename T, typename Policy, typename> class Head;
+
     /// @class `Var`
     /// @brief A variable reference to an element saved within a DimaSlot. When this vaiable access goes out of scope (RAII-based), the ARC
     /// counter of said DIMA slot will be reduced
@@ -18,53 +40,83 @@ namespace dima {
     /// - Access to the referenced object is NOT thread-safe
     /// - Users must provide their own synchronization when accessing the object from multiple threads
     template <typename T, typename = std::enable_if_t<std::is_class_v<T>>> //
-    class Var {
+    class Var : private VarLinks<Var<T>, slot_compaction<T>::enabled> {
       public:
         // Destructor
         ~Var() {
-            slot->release();
+            if (slot != nullptr) {
+                unlink();
+                slot->release();
+            }
         }
         // Constructor
         explicit Var(Slot<T> *slot) :
-            slot(slot) {};
+            slot(slot) {
+            link();
+        };
 
         // Copy constructor
-        Var(const Var &other) {
-            slot = other.slot;
-            slot->retain();
+        Var(const Var &other) :
+            slot(other.slot) {
+            if (slot != nullptr) {
+                slot->retain();
+                link();
+            }
         }
-        // Move constructor
-        Var(Var &&other) {
-            slot = other.slot;
-            slot->retain();
+        // Move constructor, which steals the reference of `other` and leaves it null
+        Var(Var &&other) noexcept :
+            slot(other.slot) {
+            if (slot != nullptr) {
+                take_links(other);
+                other.slot = nullptr;
+            }
         }
         // Copy assignment
         Var &operator=(const Var &other) {
             if (this != &other) {
                 Slot<T> *old_slot = slot;
+                if (old_slot != nullptr) {
+                    unlink();
+                }
                 slot = other.slot;
-                slot->retain();
-                old_slot->release();
+                if (slot != nullptr) {
+                    slot->retain();
+                    link();
+                }
+                if (old_slot != nullptr) {
+                    old_slot->release();
+                }
             }
             return *this;
         }
-        // Move assignment
-        Var &operator=(Var &&other) {
+        // Move assignment, which steals the reference of `other` and leaves it null
+        Var &operator=(Var &&other) noexcept {
             if (this != &other) {
                 Slot<T> *old_slot = slot;
+                if (old_slot != nullptr) {
+                    unlink();
+                }
                 slot = other.slot;
-                slot->retain();
-                old_slot->release();
+                if (slot != nullptr) {
+                    take_links(other);
+                    other.slot = nullptr;
+                }
+                if (old_slot != nullptr) {
+                    old_slot->release();
+                }
             }
             return *this;
         }
 
         // This operator makes working with variables a lot easier, as the data saved inside the slot can be forwareded directly
-        // These also ensure that the slot itself stays safe and cannot be modified from within this Var class by the user
+        // These also ensure that the slot itself stays safe and cannot be modified from within this Var class by the user. A null
+        // variable has no value to access, so these must not be used on a moved-from variable
         inline T *operator->() {
+            assert(slot != nullptr);
             return slot->get();
         }
         const inline T *operator->() const {
+            assert(slot != nullptr);
             return slot->get();
         }
 
@@ -73,23 +125,144 @@ namespace dima {
         /// @brief The dima slot this variable refers to
         Slot<T> *slot;
 
+        friend class Slot<T>;
+        template <typename> friend class Ref;
+        template <typename> friend class WeakVar;
+        template <typename> friend class Handle;
+        template <typename> friend class WeakHandle;
+        template <typename, typename, typename> friend class Head;
+
+        /// @function `link`
+        /// @brief Adds this variable to the list of variables referring to its slot, if the slot keeps such a list
+        inline void link() {
+            if constexpr (Slot<T>::TRACKED) {
+                this->prev_reference = nullptr;
+                this->next_reference = slot->references;
+                if (this->next_reference != nullptr) {
+                    this->next_reference->prev_reference = this;
+                }
+                slot->references = this;
+            }
+        }
+
+        /// @function `unlink`
+        /// @brief Removes this variable from the list of variables referring to its slot, if the slot keeps such a list
+        inline void unlink() {
+            if constexpr (Slot<T>::TRACKED) {
+                if (this->prev_reference != nullptr) {
+                    this->prev_reference->next_reference = this->next_reference;
+                } else {
+                    slot->references = this->next_reference;
+                }
+                if (this->next_reference != nullptr) {
+                    this->next_reference->prev_reference = this->prev_reference;
+                }
+            }
+        }
+
+        /// @function `take_links`
+        /// @brief Puts this variable in the place of `other` in the list of variables referring to their slot, if the slot keeps such a
+        /// list
+        ///
+        /// @param `other` The variable whose place this variable takes
+        inline void take_links(Var &other) {
+            if constexpr (Slot<T>::TRACKED) {
+                this->prev_reference = other.prev_reference;
+                this->next_reference = other.next_reference;
+                if (this->prev_reference != nullptr) {
+                    this->prev_reference->next_reference = this;
+                } else {
+                    slot->references = this;
+                }
+                if (this->next_reference != nullptr) {
+                    this->next_reference->prev_reference = this;
+                }
+            }
+        }
+
         // Here are the non-core public functions. Everything above cannot be removed, these are additional functions publically available
         // to call. All functions here can be called with the `.` syntax on dima variables directly
       public:
+        /// @function `is_null`
+        /// @brief Checks whether this variable refers to nothing, which is only the case after it has been moved from
+        ///
+        /// @return `bool` Whether this variable refers to nothing
+        inline bool is_null() const {
+            return slot == nullptr;
+        }
+
         /// @function `get_arc_count`
         /// @brief Returns the reference count the slot this variable operates on has
         ///
-        /// @return `size_t` The reference count of the slot this variable operates on
+        /// @return `size_t` The reference count of the slot this variable operates on, 0 if this variable is null
         inline size_t get_arc_count() {
-            return slot->arc;
+            return slot != nullptr ? slot->get_arc() : 0;
         }
 
         /// @function `get`
-        /// @brief Returns a raw pointer to the value saved inside the DIMA slot this Var references
+        /// @brief Returns a raw pointer to the value saved inside the DIMA slot this Var references. For compactable types the pointer only
+        /// stays valid until the next compaction step, unless the value is pinned
         ///
-        /// @return `T *const` The raw pointer to the value in the DIMA Slot, which cannot be changed
-        inline T *const get() {
-            return slot->get();
+        /// @return `T *` The raw pointer to the value in the DIMA Slot, nullptr if this variable is null
+        inline T *get() {
+            return slot != nullptr ? slot->get() : nullptr;
+        }
+
+        /// @function `pin`
+        /// @brief Pins the value this Var references to its place, so compaction never moves it, see `Slot::pin`. Does nothing if this
+        /// variable is null
+        inline void pin() {
+            if (slot != nullptr) {
+                slot->pin();
+            }
+        }
+
+        /// @function `unpin`
+        /// @brief Lets compaction move the value this Var references again. Does nothing if this variable is null
+        inline void unpin() {
+            if (slot != nullptr) {
+                slot->unpin();
+            }
         }
     };
+
+    /// @class `Ref`
+    /// @brief A borrowed, non-owning reference to the value of a `Var`. It converts implicitly from a `Var` and never touches the reference
+    /// count, so it suits parameters of functions which only use a value for the duration of the call. A `Ref` does not keep its value
+    /// alive, so it must not outlive the `Var` it was borrowed from, and for compactable types it must not be held across a compaction
+    /// step unless the value is pinned. Use `Ref<const T>` for read-only borrows, only those can be borrowed from a `const Var`
+    template <typename T> class Ref {
+      public:
+        Ref(Var<std::remove_const_t<T>> &var) :
+            value(var.slot != nullptr ? var.slot->get() : nullptr) {}
+
+        template <typename U = T, typename = std::enable_if_t<std::is_const_v<U>>>
+        Ref(const Var<std::remove_const_t<T>> &var) :
+            value(var.slot != nullptr ? var.slot->get() : nullptr) {}
+
+        template <typename U, typename = std::enable_if_t<std::is_same_v<const U, T>>>
+        Ref(const Ref<U> &other) :
+            value(other.get()) {}
+
+        inline T *operator->() const {
+            return value;
+        }
+
+        inline T &operator*() const {
+            return *value;
+        }
+
+        /// @function `get`
+        /// @brief Returns a raw pointer to the borrowed value
+        ///
+        /// @return `T *` The raw pointer to the borrowed value
+        inline T *get() const {
+            return value;
+        }
+
+      private:
+        /// @var `value`
+        /// @brief The borrowed value
+        T *value;
+    };
 } // namespace dima
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "block.hpp"
+#include "head.hpp"
+#include "policy.hpp"
+#include "var.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+
+/// @namespace `dima`
+/// @brief The `dima` namespace contains all classes used for the DIMA memory management system
+namespace dima {
+
+    template <typename T, typename Policy> class Type;
+
+    /// @class `WeakVar`
+    /// @brief A weak reference to a value of a DIMA type, which does not keep the value alive. It remembers where the value lives and
+    /// which generation its slot had, and it can be upgraded to a `Var` for as long as the slot still holds that same value. As it holds
+    /// no reference, its block can still be given back once every value in it is gone, and the weak variable then simply stops upgrading.
+    /// Only available for types with `weak_references` enabled in their policy. A value moved by compaction counts as a new value, so
+    /// weak variables to it stop upgrading as well
+    template <typename T> class WeakVar {
+      public:
+        WeakVar() = default;
+
+        WeakVar(const Var<T> &var) {
+            static_assert(Slot<T>::WEAK, "Only types with weak_references enabled in their policy can have weak variables");
+            if (var.slot == nullptr) {
+                return;
+            }
+            // The variable holds a reference, so the slot and its block are alive while they are looked at
+            Block<T> *block = static_cast<Block<T> *>(var.slot->get_owner());
+            block_id = block->get_id();
+            incarnation = block->get_incarnation();
+            slot_index = var.slot->index;
+            generation = var.slot->get_generation();
+            empty = false;
+        }
+
+        /// @function `upgrade`
+        /// @brief Returns a new variable to the value this weak variable refers to, if that value is still alive
+        ///
+        /// @return `std::optional<Var<T>>` A variable to the value, nullopt if the value is gone
+        std::optional<Var<T>> upgrade() const {
+            if (empty) {
+                return std::nullopt;
+            }
+            return Type<T, typename type_policy<T>::type>::head.upgrade(block_id, incarnation, slot_index, generation);
+        }
+
+        /// @function `is_empty`
+        /// @brief Checks whether this weak variable was never given a value to refer to
+        ///
+        /// @return `bool` Whether this weak variable refers to nothing
+        inline bool is_empty() const {
+            return empty;
+        }
+
+      private:
+        /// @var `incarnation`
+        /// @brief The incarnation of the block the value was allocated in, see `Block::incarnation`
+        uint64_t incarnation = 0;
+
+        /// @var `block_id`
+        /// @brief The id of the block the value was allocated in
+        uint32_t block_id = 0;
+
+        /// @var `slot_index`
+        /// @brief The index of the slot of the value inside of its block
+        uint32_t slot_index = 0;
+
+        /// @var `generation`
+        /// @brief The generation of the slot the value was allocated in
+        uint32_t generation = 0;
+
+        /// @var `empty`
+        /// @brief Whether this weak variable refers to nothing
+        bool empty = true;
+    };
+} // namespace dima
@@ -15,23 +15,53 @@ benchmark() {
     time ./out/"$1"/"$2" | tee ./test/results/test_outputs/"$1/$2".txt
 }
 
+# Runs a single variant of the 'dima' benchmark, see the list of variants in test/src/dima.cpp. The output of the default variant keeps
+# the name of the executable, the outputs of all other variants carry the name of their variant, for example 'dima-split-medium-o1'
+# $1 - The name of the executable to benchmark
+# $2 - The name of the variant to run
+benchmark_variant() {
+    if [ "$2" = "default" ]; then
+        output="$1"
+    else
+        output="dima-$2${1#dima}"
+    fi
+    echo "-- Benchmarking '$output'..."
+    touch ./test/results/test_outputs/cpp/"$output".txt
+    time ./out/cpp/"$1" "$2" | tee ./test/results/test_outputs/cpp/"$output".txt
+}
+
+# The contention benchmarks print a per-thread-count table instead of the per-allocation-count table, so their outputs are kept
+# apart from the outputs which are converted to csv
+# $1 - The name of the executable to benchmark
+benchmark_concurrent() {
+    echo "-- Benchmarking '$1'..."
+    touch ./test/results/test_outputs/concurrent/"$1".txt
+    time ./out/cpp/"$1" | tee ./test/results/test_outputs/concurrent/"$1".txt
+}
+
 mkdir -p ./test/results/test_outputs
+mkdir -p ./test/results/test_outputs/concurrent
 mkdir -p ./test/results/test_outputs/cpp
 mkdir -p ./test/results/test_outputs/c
 
 if [ "$1" != "skip_cpp" ]; then
-    benchmark cpp dima
-    benchmark cpp dima-o1
-    benchmark cpp dima-medium
-    benchmark cpp dima-medium-o1
-    benchmark cpp dima-reserve
-    benchmark cpp dima-reserve-o1
-    benchmark cpp dima-reserve-medium
-    benchmark cpp dima-reserve-medium-o1
+    echo "-- Running 'dima-tests'..."
+    ./out/cpp/dima-tests || exit 1
+
+    for variant in $(./out/cpp/dima list); do
+        benchmark_variant dima "$variant"
+        benchmark_variant dima-o1 "$variant"
+        benchmark_variant dima-medium "$variant"
+        benchmark_variant dima-medium-o1 "$variant"
+    done
     benchmark cpp dima-array
     benchmark cpp dima-array-o1
     benchmark cpp dima-array-medium
     benchmark cpp dima-array-medium-o1
+    benchmark_concurrent dima-concurrent
+    benchmark_concurrent dima-concurrent-o1
+    benchmark_concurrent dima-concurrent-medium
+    benchmark_concurrent dima-concurrent-medium-o1
     benchmark cpp std-shared
     benchmark cpp std-shared-o1
     benchmark cpp std-shared-medium
@@ -57,18 +57,23 @@ if [ "$1" != "skip_cpp" ]; then
     echo
     echo "-- Building the C++ test binaries..."
 
+    # Every policy variant of the benchmark is part of the same binaries, see the list of variants in test/src/dima.cpp. This includes
+    # the reserve configuration, so 'dima-reserve' and 'dima-reserve-medium' are no separate builds anymore, their results are produced
+    # by running 'dima reserve' and 'dima-medium reserve' (see benchmark.sh)
     echo "-- Building 'dima'..."
-    build_cpp dima.cpp dima
+    build_cpp dima.cpp dima -pthread
     echo "-- Building 'dima-medium'..."
-    build_cpp dima.cpp dima-medium -DMEDIUM_TEST
-    echo "-- Building 'dima-reserve'..."
-    build_cpp dima.cpp dima-reserve -DDIMA_RESERVE
-    echo "-- Building 'dima-reserve-medium'..."
-    build_cpp dima.cpp dima-reserve-medium -DIMA_RESERVE -DMEDIUM_TEST
+    build_cpp dima.cpp dima-medium -DMEDIUM_TEST -pthread
     echo "-- Building 'dima-array'..."
     build_cpp dima_array.cpp dima-array
     echo "-- Building 'dima-array-medium'..."
     build_cpp dima_array.cpp dima-array-medium -DMEDIUM_TEST
+    echo "-- Building 'dima-tests'..."
+    build_cpp dima_tests.cpp dima-tests -pthread
+    echo "-- Building 'dima-concurrent'..."
+    build_cpp dima_concurrent.cpp dima-concurrent -pthread
+    echo "-- Building 'dima-concurrent-medium'..."
+    build_cpp dima_concurrent.cpp dima-concurrent-medium -DMEDIUM_TEST -pthread
 
     echo "-- Building 'std-shared'..."
     build_cpp std_shared.cpp std-shared
@@ -80,17 +85,17 @@ if [ "$1" != "skip_cpp" ]; then
     build_cpp std_unique.cpp std-unique-medium -DMEDIUM_TEST
 
     echo "-- Building 'dima-o1'..."
-    build_cpp dima.cpp dima-o1 -O1
+    build_cpp dima.cpp dima-o1 -pthread -O1
     echo "-- Building 'dima-medium-o1'..."
-    build_cpp dima.cpp dima-medium-o1 -DMEDIUM_TEST -O1
-    echo "-- Building 'dima-reserve-o1'..."
-    build_cpp dima.cpp dima-reserve-o1 -DDIMA_RESERVE -O1
-    echo "-- Building 'dima-reserve-medium-o1'..."
-    build_cpp dima.cpp dima-reserve-medium-o1 -DDIMA_RESERVE -DMEDIUM_TEST -O1
+    build_cpp dima.cpp dima-medium-o1 -DMEDIUM_TEST -pthread -O1
     echo "-- Building 'dima-array-o1'..."
     build_cpp dima_array.cpp dima-array-o1 -O1
     echo "-- Building 'dima-array-medium-o1'..."
     build_cpp dima_array.cpp dima-array-medium-o1 -DMEDIUM_TEST -O1
+    echo "-- Building 'dima-concurrent-o1'..."
+    build_cpp dima_concurrent.cpp dima-concurrent-o1 -pthread -O1
+    echo "-- Building 'dima-concurrent-medium-o1'..."
+    build_cpp dima_concurrent.cpp dima-concurrent-medium-o1 -DMEDIUM_TEST -pthread -O1
 
     echo "-- Building 'std-shared-o1'..."
     build_cpp std_shared.cpp std-shared-o1 -O1
@@ -4,7 +4,11 @@
 #include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstring>
+#include <iterator>
+#include <optional>
 #include <string>
+#include <thread>
 
 #include <dima/type.hpp>
 
@@ -14,7 +18,9 @@
 #define VALUES_LEN 64
 #endif
 
-class Expression : public dima::Type<Expression> {
+// The benchmark runs the same workload for every variant in the list at the bottom of this file, a variant is a policy of the benchmarked
+// type plus the way its values are allocated and referenced. Which parts of the workload a variant takes is decided by its policy
+template <typename Policy> class Expression : public dima::Type<Expression<Policy>, Policy> {
   public:
     std::array<double, VALUES_LEN> values; // 512 / 64 Bytes of data
 
@@ -34,8 +40,45 @@ class Expression : public dima::Type<Expression> {
     std::string type;
 };
 
-void apply_complex_operation(std::vector<dima::Var<Expression>> &variables) {
-    for (auto &expr : variables) {
+// How the values of a variant are allocated and referenced
+enum class Mode {
+    PLAIN,   // One value after another, referenced through variables
+    RESERVE, // Like `PLAIN`, but the vector of variables is reserved up front, which is what the `DIMA_RESERVE` builds measured
+    BULK,    // All values at once through `allocate_bulk`, released through `release_bulk`
+    HANDLES, // Like `PLAIN`, but from then on the values are only referenced through handles
+};
+
+struct SplitPolicy : dima::default_policy {
+    using layout = dima::split_layout;
+};
+
+struct RetainedPolicy : dima::default_policy {
+    using retention = dima::keep_empty_blocks<4>;
+};
+
+struct MmapPolicy : dima::default_policy {
+    using memory = dima::mmap_memory<>;
+};
+
+struct HugePagePolicy : dima::default_policy {
+    using memory = dima::huge_page_memory<>;
+};
+
+struct ReservedRangePolicy : dima::default_policy {
+    using memory = dima::reserved_range_memory<>;
+};
+
+struct CompactionPolicy : dima::default_policy {
+    using compaction = dima::incremental_compaction<>;
+};
+
+struct WeakPolicy : dima::default_policy {
+    static constexpr bool weak_references = true;
+};
+
+template <typename Ref> void apply_complex_operation(std::vector<Ref> &references) {
+    // With handles every access resolves the handle through the block table
+    for (auto &expr : references) {
         // Operations that use more of the object data
         for (size_t i = 0; i < expr->values.size(); i++) {
             expr->values[i] = std::sin(expr->values[i]) * std::cos(expr->values[i]);
@@ -43,21 +86,44 @@ void apply_complex_operation(std::vector<dima::Var<Expression>> &variables) {
     }
 }
 
-void apply_simple_operation(std::vector<dima::Var<Expression>> &variables) {
-    // Use parallel_foreach to modify all expressions
+// The expression is only borrowed for the duration of the call, so passing it never touches its reference count
+template <typename Policy> void apply_simple_operation(dima::Ref<Expression<Policy>> expr) {
+    // Get the current type
+    std::string current_type = expr->get_type();
+
+    // Transform it
+    std::transform(current_type.begin(), current_type.end(), current_type.begin(), ::toupper);
+
+    // Update the expression
+    expr->set_type(current_type + "_PROCESSED");
+}
+
+template <typename Policy> void apply_simple_operation(std::vector<dima::Var<Expression<Policy>>> &variables) {
     for (auto &expr : variables) {
-        // Get the current type
-        std::string current_type = expr->get_type();
+        apply_simple_operation<Policy>(expr);
+    }
+}
 
-        // Transform it
-        std::transform(current_type.begin(), current_type.end(), current_type.begin(), ::toupper);
+template <typename Policy> void apply_simple_operation(std::vector<dima::Handle<Expression<Policy>>> &handles) {
+    // Every value is reached through a variable the handle hands out
+    for (auto &handle : handles) {
+        dima::Var<Expression<Policy>> expr = handle.get_var();
+        apply_simple_operation<Policy>(expr);
+    }
+}
 
-        // Update the expression
-        expr->set_type(current_type + "_PROCESSED");
+template <typename Policy> void apply_simple_operation(std::vector<dima::WeakVar<Expression<Policy>>> &weak_variables) {
+    // Every value is reached through an upgrade of its weak variable
+    for (auto &weak : weak_variables) {
+        if (std::optional<dima::Var<Expression<Policy>>> expr = weak.upgrade()) {
+            apply_simple_operation<Policy>(expr.value());
+        }
     }
 }
 
+template <typename Policy, Mode mode>
 std::tuple<duration, duration, duration, duration, size_t, size_t, size_t> test_n_allocations(const size_t n) {
+    using Expr = Expression<Policy>;
     auto start = std::chrono::high_resolution_clock::now();
     auto alloc_time = start;
     auto simple_time = start;
@@ -67,26 +133,92 @@ std::tuple<duration, duration, duration, duration, size_t, size_t, size_t> test_
     size_t slot_capacity = 0;
     {
         // Create multiple expressions
-        std::vector<dima::Var<Expression>> variables;
-#if defined(DIMA_RESERVE)
-        variables.reserve(n);
-#endif
-        for (int i = 0; i < n; i++) {
-            variables.emplace_back(Expression::allocate(std::string("expr_") + std::to_string(i)));
+        std::vector<dima::Var<Expr>> variables;
+        if constexpr (mode == Mode::RESERVE) {
+            variables.reserve(n);
         }
-        slot_capacity = Expression::get_capacity();
-        alloc_time = std::chrono::high_resolution_clock::now();
+        if constexpr (mode == Mode::BULK) {
+            Expr::allocate_bulk(n, std::back_inserter(variables), [](const size_t i) {
+                return Expr(std::string("expr_") + std::to_string(i));
+            });
+        } else if constexpr (Policy::biased_references) {
+            // The values are allocated on a thread which exits right away, so every release on this thread has to merge the local count
+            // the exited owner left behind
+            std::thread([&variables, n]() {
+                for (size_t i = 0; i < n; i++) {
+                    variables.emplace_back(Expr::allocate(std::string("expr_") + std::to_string(i)));
+                }
+            }).join();
+        } else {
+            for (size_t i = 0; i < n; i++) {
+                variables.emplace_back(Expr::allocate(std::string("expr_") + std::to_string(i)));
+            }
+        }
+        if constexpr (mode == Mode::HANDLES) {
+            // From here on the values are only kept alive by their handles
+            std::vector<dima::Handle<Expr>> handles(variables.begin(), variables.end());
+            variables.clear();
+            slot_capacity = Expr::get_capacity();
+            alloc_time = std::chrono::high_resolution_clock::now();
+
+            // Now the operations
+            apply_simple_operation<Policy>(handles);
+            simple_time = std::chrono::high_resolution_clock::now();
+            apply_complex_operation(handles);
+            complex_time = std::chrono::high_resolution_clock::now();
+
+            memory_usage = get_memory_usage();
+            dealloc_start = std::chrono::high_resolution_clock::now();
+        } else if constexpr (Policy::weak_references) {
+            // The values are only reached through weak variables during the simple operations
+            std::vector<dima::WeakVar<Expr>> weak_variables(variables.begin(), variables.end());
+            slot_capacity = Expr::get_capacity();
+            alloc_time = std::chrono::high_resolution_clock::now();
 
-        // Now the operations
-        apply_simple_operation(variables);
-        simple_time = std::chrono::high_resolution_clock::now();
-        apply_complex_operation(variables);
-        complex_time = std::chrono::high_resolution_clock::now();
+            // Now the operations
+            apply_simple_operation<Policy>(weak_variables);
+            simple_time = std::chrono::high_resolution_clock::now();
+            apply_complex_operation(variables);
+            complex_time = std::chrono::high_resolution_clock::now();
 
-        memory_usage = get_memory_usage();
-        dealloc_start = std::chrono::high_resolution_clock::now();
+            memory_usage = get_memory_usage();
+            dealloc_start = std::chrono::high_resolution_clock::now();
+        } else {
+            slot_capacity = Expr::get_capacity();
+            alloc_time = std::chrono::high_resolution_clock::now();
+
+            // Now the operations
+            apply_simple_operation<Policy>(variables);
+            simple_time = std::chrono::high_resolution_clock::now();
+            apply_complex_operation(variables);
+            complex_time = std::chrono::high_resolution_clock::now();
+
+            memory_usage = get_memory_usage();
+            dealloc_start = std::chrono::high_resolution_clock::now();
+        }
+        if constexpr (mode == Mode::BULK) {
+            Expr::release_bulk(variables);
+        }
+        if constexpr (Policy::compaction::enabled) {
+            // Only every fourth value survives, which leaves every block sparse enough to be compacted
+            std::vector<dima::Var<Expr>> survivors;
+            survivors.reserve(n / 4 + 1);
+            for (size_t i = 0; i < n; i += 4) {
+                survivors.emplace_back(std::move(variables[i]));
+            }
+            variables.clear();
+            while (Expr::compact(std::chrono::microseconds(100)) > 0) {}
+        }
+    }
+    if constexpr (Policy::deferred_reclamation) {
+        // The released values are only destroyed here, in steps of at most 100 microseconds
+        while (dima::reclaim(std::chrono::microseconds(100)) > 0) {}
     }
     auto end = std::chrono::high_resolution_clock::now();
+    if constexpr (Policy::retention::max_blocks > 0) {
+        // The last emptied blocks were kept alive by the retention policy, they are given back before the next run
+        Expr::trim();
+    }
     std::chrono::duration<double, std::milli> alloc_dur = alloc_time - start;
     std::chrono::duration<double, std::milli> calc_simp = simple_time - alloc_time;
     std::chrono::duration<double, std::milli> calc_comp = complex_time - simple_time;
@@ -94,53 +226,65 @@ std::tuple<duration, duration, duration, duration, size_t, size_t, size_t> test_
     return {alloc_dur, calc_simp, calc_comp, dealloc_time, memory_usage, n, slot_capacity};
 }
 
-int main() {
+template <typename Policy, Mode mode> void run_benchmark() {
     std::vector<std::pair<size_t, std::tuple<duration, duration, duration, duration, size_t, size_t, size_t>>> all_results;
 
     // Run tests with increasing object counts
-    all_results.emplace_back(100, test_n_allocations(100));           // 100
-    all_results.emplace_back(500, test_n_allocations(500));           // 500
-    all_results.emplace_back(1000, test_n_allocations(1000));         // 1.000
-    all_results.emplace_back(5000, test_n_allocations(5000));         // 5.000
-    all_results.emplace_back(10000, test_n_allocations(10000));       // 10.000
-    all_results.emplace_back(50000, test_n_allocations(50000));       // 50.000
-    all_results.emplace_back(100000, test_n_allocations(100000));     // 100.000
-    all_results.emplace_back(500000, test_n_allocations(500000));     // 500.000
-    all_results.emplace_back(1000000, test_n_allocations(1000000));   // 1.000.000
-    all_results.emplace_back(2000000, test_n_allocations(2000000));   // 2.000.000
-    all_results.emplace_back(3000000, test_n_allocations(3000000));   // 3.000.000
-    all_results.emplace_back(4000000, test_n_allocations(4000000));   // 4.000.000
-    all_results.emplace_back(5000000, test_n_allocations(5000000));   // 5.000.000
-    all_results.emplace_back(5000000, test_n_allocations(5000000));   // 5.000.000
-    all_results.emplace_back(6000000, test_n_allocations(6000000));   // 6.000.000
-    all_results.emplace_back(7000000, test_n_allocations(7000000));   // 7.000.000
-    all_results.emplace_back(8000000, test_n_allocations(8000000));   // 8.000.000
-    all_results.emplace_back(9000000, test_n_allocations(9000000));   // 9.000.000
-    all_results.emplace_back(10000000, test_n_allocations(10000000)); // 10.000.000
-    all_results.emplace_back(11000000, test_n_allocations(11000000)); // 11.000.000
-    all_results.emplace_back(12000000, test_n_allocations(12000000)); // 12.000.000
-    all_results.emplace_back(13000000, test_n_allocations(13000000)); // 13.000.000
-    all_results.emplace_back(14000000, test_n_allocations(14000000)); // 14.000.000
-    all_results.emplace_back(15000000, test_n_allocations(15000000)); // 15.000.000
-    all_results.emplace_back(16000000, test_n_allocations(16000000)); // 16.000.000
+    const std::vector<size_t> counts = {
+        100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000, 2000000, 3000000, 4000000, 5000000, 5000000, 6000000, 7000000,
+        8000000, 9000000, 10000000, 11000000, 12000000, 13000000, 14000000, 15000000, 16000000,
 #if defined(MEDIUM_TEST)
-    all_results.emplace_back(17000000, test_n_allocations(17000000)); // 17.000.000
-    all_results.emplace_back(18000000, test_n_allocations(18000000)); // 18.000.000
-    all_results.emplace_back(19000000, test_n_allocations(19000000)); // 19.000.000
-    all_results.emplace_back(20000000, test_n_allocations(20000000)); // 20.000.000
-    all_results.emplace_back(21000000, test_n_allocations(21000000)); // 21.000.000
-    all_results.emplace_back(22000000, test_n_allocations(22000000)); // 22.000.000
-    all_results.emplace_back(23000000, test_n_allocations(23000000)); // 23.000.000
-    all_results.emplace_back(24000000, test_n_allocations(24000000)); // 24.000.000
-    all_results.emplace_back(25000000, test_n_allocations(25000000)); // 25.000.000
-    all_results.emplace_back(26000000, test_n_allocations(26000000)); // 26.000.000
-    all_results.emplace_back(27000000, test_n_allocations(27000000)); // 27.000.000
-    all_results.emplace_back(28000000, test_n_allocations(28000000)); // 28.000.000
-    all_results.emplace_back(29000000, test_n_allocations(29000000)); // 29.000.000
-    all_results.emplace_back(30000000, test_n_allocations(30000000)); // 30.000.000
+        17000000, 18000000, 19000000, 20000000, 21000000, 22000000, 23000000, 24000000, 25000000, 26000000, 27000000, 28000000, 29000000,
+        30000000,
 #endif
+    };
+    for (const size_t count : counts) {
+        all_results.emplace_back(count, test_n_allocations<Policy, mode>(count));
+    }
 
     // Print formatted results
     print_results_table(all_results);
-    return 0;
+}
+
+struct Variant {
+    const char *name;
+    void (*run)();
+};
+
+// Every variant is benchmarked in its own process, so the memory usage of one variant never shows up in the results of another
+const Variant VARIANTS[] = {
+    {"default", run_benchmark<dima::default_policy, Mode::PLAIN>},
+    // Replaces the old `-DDIMA_RESERVE` binaries, its outputs keep their names (`dima-reserve`, `dima-reserve-medium-o1`, ...)
+    {"reserve", run_benchmark<dima::default_policy, Mode::RESERVE>},
+    {"bulk", run_benchmark<dima::default_policy, Mode::BULK>},
+    {"split", run_benchmark<SplitPolicy, Mode::PLAIN>},
+    {"single", run_benchmark<dima::single_threaded, Mode::PLAIN>},
+    {"deferred", run_benchmark<dima::deferred, Mode::PLAIN>},
+    {"retained", run_benchmark<RetainedPolicy, Mode::PLAIN>},
+    {"mmap", run_benchmark<MmapPolicy, Mode::PLAIN>},
+    {"huge-page", run_benchmark<HugePagePolicy, Mode::PLAIN>},
+    {"reserved-range", run_benchmark<ReservedRangePolicy, Mode::PLAIN>},
+    {"compaction", run_benchmark<CompactionPolicy, Mode::PLAIN>},
+    {"thread-biased", run_benchmark<dima::thread_biased, Mode::PLAIN>},
+    {"weak", run_benchmark<WeakPolicy, Mode::PLAIN>},
+    {"handles", run_benchmark<dima::default_policy, Mode::HANDLES>},
+};
+
+// Runs the variant named by the first argument, `default` if there is none. `list` prints the names of all variants instead
+int main(int argc, char *argv[]) {
+    const char *name = argc > 1 ? argv[1] : "default";
+    if (std::strcmp(name, "list") == 0) {
+        for (const Variant &variant : VARIANTS) {
+            std::cout << variant.name << std::endl;
+        }
+        return 0;
+    }
+    for (const Variant &variant : VARIANTS) {
+        if (std::strcmp(name, variant.name) == 0) {
+            variant.run();
+            return 0;
+        }
+    }
+    std::cerr << "Unknown variant '" << name << "', see 'list' for all variants" << std::endl;
+    return 1;
 }
@@ -0,0 +1,158 @@
+#include "formatting.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dima/block.hpp>
+#include <dima/type.hpp>
+
+#if defined(MEDIUM_TEST)
+#define OPS_PER_THREAD 200000
+#else
+#define OPS_PER_THREAD 1000000
+#endif
+
+// How many slots every thread keeps alive at once, the rest is released again right away
+#define LIVE_PER_THREAD 64
+
+class Particle {
+  public:
+    double x, y;
+    size_t owner;
+
+    Particle(const size_t owner) :
+        x(0),
+        y(0),
+        owner(owner) {}
+};
+
+class CachedParticle : public dima::Type<CachedParticle, dima::multi_threaded> {
+  public:
+    double x, y;
+    size_t owner;
+
+    CachedParticle(const size_t owner) :
+        x(0),
+        y(0),
+        owner(owner) {}
+};
+
+class ConcurrentParticle : public dima::Type<ConcurrentParticle, dima::concurrent> {
+  public:
+    double x, y;
+    size_t owner;
+
+    ConcurrentParticle(const size_t owner) :
+        x(0),
+        y(0),
+        owner(owner) {}
+};
+
+// A variable of a block which is not thread safe, so every release of its slot has to happen under the lock of that block
+class LockedVar {
+  public:
+    LockedVar(std::mutex &mutex, dima::Var<Particle> &&var) :
+        mutex(mutex),
+        var(std::move(var)) {}
+
+    ~LockedVar() {
+        std::lock_guard<std::mutex> lock(mutex);
+        var.reset();
+    }
+
+  private:
+    std::mutex &mutex;
+    std::optional<dima::Var<Particle>> var;
+};
+
+void check(const bool condition, const std::string &message) {
+    if (!condition) {
+        std::cerr << "-- Stress test failed: " << message << std::endl;
+        std::exit(1);
+    }
+}
+
+// Lets all threads allocate from and release into the blocks of a single type shared between threads, checks that no slot is ever handed
+// out twice and that every slot is back once all threads are done
+template <typename SharedParticle> void stress_test(const size_t thread_count) {
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_count; t++) {
+        threads.emplace_back([t]() {
+            std::vector<dima::Var<SharedParticle>> live;
+            for (size_t i = 0; i < OPS_PER_THREAD / 10; i++) {
+                live.emplace_back(SharedParticle::allocate(t));
+                if (live.size() >= LIVE_PER_THREAD / 2) {
+                    // If another thread had overwritten one of our slots, its owner would differ
+                    for (auto &v : live) {
+                        check(v->owner == t, "a slot was handed out to two threads");
+                    }
+                    live.clear();
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    check(SharedParticle::get_allocation_count() == 0, "the occupied count does not match the live variables");
+}
+
+// Every thread allocates and releases `OPS_PER_THREAD` slots, keeping up to `LIVE_PER_THREAD` of them alive at once
+template <typename Allocate> duration run_contention(const size_t thread_count, Allocate &&allocate) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_count; t++) {
+        threads.emplace_back([&allocate, t]() {
+            std::vector<decltype(allocate(t))> live;
+            live.reserve(LIVE_PER_THREAD);
+            for (size_t i = 0; i < OPS_PER_THREAD; i++) {
+                live.emplace_back(allocate(t));
+                if (live.size() == LIVE_PER_THREAD) {
+                    live.clear();
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    return std::chrono::high_resolution_clock::now() - start;
+}
+
+int main() {
+    const size_t max_threads = std::max(2u, std::thread::hardware_concurrency());
+
+    std::cout << "-- Running the stress test..." << std::endl;
+    for (size_t thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+        stress_test<CachedParticle>(thread_count);
+        stress_test<ConcurrentParticle>(thread_count);
+    }
+    std::cout << "-- Stress test passed" << std::endl << std::endl;
+
+    std::cout << "| Threads | Block + mutex   | Thread cached   | Concurrent      |" << std::endl;
+    std::cout << "|---------|-----------------|-----------------|-----------------|" << std::endl;
+    for (size_t thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+        const size_t capacity = thread_count * LIVE_PER_THREAD;
+
+        dima::Block<Particle> locked_block(0, capacity);
+        std::mutex block_mutex;
+        const duration locked = run_contention(thread_count, [&locked_block, &block_mutex](const size_t t) {
+            std::lock_guard<std::mutex> lock(block_mutex);
+            return LockedVar(block_mutex, locked_block.allocate(t).value());
+        });
+
+        const duration cached = run_contention(thread_count, [](const size_t t) { return CachedParticle::allocate(t); });
+
+        const duration concurrent = run_contention(thread_count, [](const size_t t) { return ConcurrentParticle::allocate(t); });
+
+        std::cout << "| " << std::setw(7) << thread_count << " | " << std::setw(15) << format_duration(locked) << " | " << std::setw(15)
+                  << format_duration(cached) << " | " << std::setw(15) << format_duration(concurrent) << " |" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,690 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dima/bitmap.hpp>
+#include <dima/handle.hpp>
+#include <dima/type.hpp>
+#include <dima/weak.hpp>
+
+void check(const bool condition, const std::string &message) {
+    if (!condition) {
+        std::cerr << "-- Unit test failed: " << message << std::endl;
+        std::exit(1);
+    }
+}
+
+// A type whose constructor throws on request, allocated through the uncached path of the default policy
+class Thrower : public dima::Type<Thrower> {
+  public:
+    int value;
+
+    Thrower(const bool fail, const int value = 0) :
+        value(value) {
+        if (fail) {
+            throw std::runtime_error("Thrower");
+        }
+    }
+};
+
+// The same type allocated through the thread caches
+class CachedThrower : public dima::Type<CachedThrower, dima::multi_threaded> {
+  public:
+    int value;
+
+    CachedThrower(const bool fail, const int value = 0) :
+        value(value) {
+        if (fail) {
+            throw std::runtime_error("CachedThrower");
+        }
+    }
+};
+
+// Calls the given function and checks that it threw
+template <typename Func> void check_throws(Func &&func, const std::string &message) {
+    bool thrown = false;
+    try {
+        func();
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    check(thrown, message);
+}
+
+// A throwing constructor must hand its slot back, no matter whether it was taken from a block or from a thread cache
+template <typename T> void test_throwing_constructor(const std::string &name) {
+    check_throws([]() { T::allocate(true); }, name + ": the constructor did not throw");
+    check(T::get_allocation_count() == 0, name + ": a throwing constructor leaked its slot");
+
+    std::vector<dima::Var<T>> vars;
+    for (int i = 0; i < 100; i++) {
+        vars.emplace_back(T::allocate(false, i));
+    }
+    check_throws([]() { T::allocate(true); }, name + ": the constructor did not throw");
+    check(T::get_allocation_count() == 100, name + ": a throwing constructor leaked its slot next to live values");
+    for (int i = 0; i < 100; i++) {
+        check(vars[i]->value == i, name + ": a throwing constructor changed a live value");
+    }
+    vars.clear();
+    check(T::get_allocation_count() == 0, name + ": not all slots were handed back");
+}
+
+// A type whose constructor throws once a given number of values have been constructed, to fail in the middle of an array
+class ArrayThrower : public dima::Type<ArrayThrower> {
+  public:
+    static inline int constructions_left = 0;
+
+    int value;
+
+    ArrayThrower(const int value) :
+        value(value) {
+        if (constructions_left-- == 0) {
+            throw std::runtime_error("ArrayThrower");
+        }
+    }
+};
+
+// An array whose element constructor throws destroys the elements built so far and leaves all of its slots free, and the block created
+// for it is handed to the retention policy like any emptied block
+void test_throwing_array() {
+    ArrayThrower::constructions_left = 3;
+    check_throws([]() { ArrayThrower::allocate_array(10, 7); }, "array: the constructor did not throw");
+    check(ArrayThrower::get_allocation_count() == 0, "array: a throwing element constructor leaked slots");
+    check(ArrayThrower::get_capacity() == 0, "array: the block emptied by a throwing element constructor was not given back");
+
+    ArrayThrower::constructions_left = 10;
+    dima::Array<ArrayThrower> array = ArrayThrower::allocate_array(10, 7);
+    check(ArrayThrower::get_allocation_count() == 10, "array: the array was not allocated");
+    for (size_t i = 0; i < array.size(); i++) {
+        check(array[i]->value == 7, "array: an element has the wrong value");
+    }
+}
+
+// A throwing generator ends a bulk allocation, the values created before it stay alive and all slots reserved for the remaining values
+// are handed back, no matter whether the slots came from a block or from a thread cache
+template <typename T> void test_throwing_bulk(const std::string &name) {
+    std::vector<dima::Var<T>> vars;
+    check_throws([&vars]() {
+        T::allocate_bulk(200, std::back_inserter(vars), [](const size_t i) { return T(i == 130, static_cast<int>(i)); });
+    }, name + ": the generator did not throw");
+    check(vars.size() == 130, name + ": the values created before the throwing generator were not written");
+    check(T::get_allocation_count() == 130, name + ": a throwing generator leaked the slots of the remaining values");
+    for (size_t i = 0; i < vars.size(); i++) {
+        check(vars[i]->value == static_cast<int>(i), name + ": a value created before the throwing generator changed");
+    }
+    vars.clear();
+    check(T::get_allocation_count() == 0, name + ": not all slots were handed back");
+}
+
+// A thread cached type whose constructor releases another value of the same type
+class CachedReleaser : public dima::Type<CachedReleaser, dima::multi_threaded> {
+  public:
+    int value;
+
+    CachedReleaser(std::vector<dima::Var<CachedReleaser>> *released, const int value) :
+        value(value) {
+        released->clear();
+    }
+};
+
+// A constructor releasing a value gives that slot back to the cache it was allocated from, which must not change the slot of the value
+// it constructs
+void test_releasing_constructor() {
+    std::vector<dima::Var<CachedReleaser>> released;
+    for (int i = 0; i < 10; i++) {
+        released.emplace_back(CachedReleaser::allocate(&released, i));
+    }
+    dima::Var<CachedReleaser> var = CachedReleaser::allocate(&released, 7);
+    check(var->value == 7, "releasing constructor: the variable refers to the released slot");
+    check(CachedReleaser::get_allocation_count() == 1, "releasing constructor: the constructed slot leaked");
+}
+
+// Threads which end right while the head their caches belong to is destroyed must neither give their slots back to the destroyed head
+// nor miss giving them back to a live one
+void test_cache_outlives_head() {
+    for (int round = 0; round < 200; round++) {
+        auto *head = new dima::Head<CachedThrower, dima::multi_threaded, void>();
+        std::atomic<bool> allocated{false};
+        std::thread thread([head, round, &allocated]() {
+            head->allocate(false, round);
+            allocated = true;
+        });
+        while (!allocated) {
+            std::this_thread::yield();
+        }
+        delete head;
+        thread.join();
+    }
+}
+
+// A biased value whose owner counted references are released on other threads, see `dima::thread_biased`
+class Biased : public dima::Type<Biased, dima::thread_biased> {
+  public:
+    size_t value;
+
+    Biased(const size_t value) :
+        value(value) {}
+};
+
+// References released on another thread are handed over to the owner thread, which drops them when it collects them or when it exits,
+// and references released after the owner exited are dropped by the releasing thread itself
+void test_biased_handover() {
+    std::vector<dima::Var<Biased>> shared;
+    std::thread owner([&shared]() {
+        std::vector<dima::Var<Biased>> owned;
+        for (size_t i = 0; i < 1000; i++) {
+            owned.emplace_back(Biased::allocate(i));
+        }
+        std::thread releaser([&owned]() {
+            for (auto &var : owned) {
+                // The reference is counted by the owner, so releasing it on this thread hands it over
+                const dima::Var<Biased> released = std::move(var);
+            }
+        });
+        releaser.join();
+        check(Biased::get_allocation_count() == 1000, "biased: a value was freed while the owner still counted a reference");
+        dima::BiasedThreads::collect();
+        check(Biased::get_allocation_count() == 0, "biased: the handed over references were not dropped");
+
+        for (size_t i = 0; i < 1000; i++) {
+            shared.emplace_back(Biased::allocate(i));
+        }
+    });
+    owner.join();
+    check(Biased::get_allocation_count() == 1000, "biased: a value was freed when its owner exited");
+    for (size_t i = 0; i < shared.size(); i++) {
+        check(shared[i]->value == i, "biased: a value changed after its owner exited");
+    }
+    shared.clear();
+    check(Biased::get_allocation_count() == 0, "biased: the references of an exited owner were not dropped");
+}
+
+// A type with weak references, whose values are reached through handles and weak handles
+struct WeakPolicy : dima::default_policy {
+    static constexpr bool weak_references = true;
+};
+
+class Node : public dima::Type<Node, WeakPolicy> {
+  public:
+    size_t value;
+
+    Node(const size_t value) :
+        value(value) {}
+};
+
+// A stale weak handle must not upgrade, no matter how often its slot was reused or how often its block was recreated since
+void test_stale_weak_handles() {
+    check(sizeof(dima::WeakHandle<Node>) == 12, "weak handle: a weak handle is not 12 bytes large");
+    // The anchor keeps the block alive, so the released slot is reused over and over within the same incarnation of the block
+    dima::Var<Node> anchor = Node::allocate(0);
+    std::vector<dima::WeakHandle<Node>> stale;
+    for (size_t i = 1; i <= 1000; i++) {
+        dima::Var<Node> node = Node::allocate(i);
+        check(dima::WeakHandle<Node>(node).upgrade().has_value(), "weak handle: a weak handle to a live value did not upgrade");
+        stale.emplace_back(node);
+    }
+    for (const auto &weak : stale) {
+        check(!weak.upgrade().has_value(), "weak handle: a weak handle upgraded after its slot was reused");
+    }
+
+    // Releasing the anchor destroys the block, so the next value lives in a new incarnation of it
+    const dima::WeakHandle<Node> old_anchor(anchor);
+    {
+        const dima::Var<Node> released = std::move(anchor);
+    }
+    for (size_t i = 0; i < 100; i++) {
+        dima::Var<Node> node = Node::allocate(i);
+        check(!old_anchor.upgrade().has_value(), "weak handle: a weak handle upgraded to a value of a recreated block");
+    }
+    check(Node::get_allocation_count() == 0, "weak handle: not all values were freed");
+}
+
+// Tiny blocks spread the values of a type over many more blocks than a single byte could count
+struct TinyPolicy : dima::default_policy {
+    using sizing = dima::fixed_capacity<16>;
+};
+
+class SmallNode : public dima::Type<SmallNode, TinyPolicy> {
+  public:
+    size_t value;
+
+    SmallNode(const size_t value) :
+        value(value) {}
+};
+
+// Handles reach every value of a type, whether it is spread over hundreds of small blocks or lies in blocks of millions of slots
+template <typename T> void test_handle_reach(const size_t count, const std::string &name) {
+    std::vector<dima::Handle<T>> handles;
+    handles.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        handles.emplace_back(T::allocate(i));
+    }
+    for (size_t i = 0; i < count; i++) {
+        check(handles[i]->value == i, name + ": a handle resolved to the wrong value");
+    }
+    handles.clear();
+    check(T::get_allocation_count() == 0, name + ": not all values were freed");
+    check(dima::Handle<T>().get_var().is_null(), name + ": a null handle did not give a null variable");
+}
+
+// A thread cached type with weak references, whose weak references are upgraded on many threads at once
+struct SharedPolicy : dima::multi_threaded {
+    static constexpr bool weak_references = true;
+};
+
+class SharedNode : public dima::Type<SharedNode, SharedPolicy> {
+  public:
+    size_t value;
+
+    SharedNode(const size_t value) :
+        value(value) {}
+};
+
+// Upgrades running on other threads while the values are released and their blocks are destroyed and created again must only ever
+// upgrade to the values their weak references were made from
+void test_concurrent_upgrades() {
+    constexpr size_t COUNT = 20000;
+    std::vector<dima::Var<SharedNode>> values;
+    for (size_t i = 0; i < COUNT; i++) {
+        values.emplace_back(SharedNode::allocate(i));
+    }
+    const std::vector<dima::WeakVar<SharedNode>> weak_vars(values.begin(), values.end());
+    const std::vector<dima::WeakHandle<SharedNode>> weak_handles(values.begin(), values.end());
+    std::atomic<bool> stop{false};
+    std::atomic<bool> wrong{false};
+    std::vector<std::thread> upgraders;
+    for (size_t t = 0; t < 4; t++) {
+        upgraders.emplace_back([&, t]() {
+            while (!stop) {
+                for (size_t i = t; i < COUNT; i += 4) {
+                    const std::optional<dima::Var<SharedNode>> var = weak_vars[i].upgrade();
+                    const std::optional<dima::Var<SharedNode>> handle_var = weak_handles[i].upgrade();
+                    if ((var.has_value() && var.value()->value != i) || (handle_var.has_value() && handle_var.value()->value != i)) {
+                        wrong = true;
+                    }
+                }
+            }
+        });
+    }
+    // Every round empties all blocks and fills new ones, with values which are not the ones the weak references were made from
+    for (size_t round = 1; round <= 20; round++) {
+        values.clear();
+        for (size_t i = 0; i < COUNT; i++) {
+            values.emplace_back(SharedNode::allocate(COUNT + i));
+        }
+    }
+    stop = true;
+    for (auto &upgrader : upgraders) {
+        upgrader.join();
+    }
+    check(!wrong, "concurrent upgrades: a weak reference upgraded to another value");
+    for (size_t i = 0; i < COUNT; i++) {
+        check(!weak_vars[i].upgrade().has_value() && !weak_handles[i].upgrade().has_value(),
+            "concurrent upgrades: a weak reference to a released value upgraded");
+    }
+    values.clear();
+}
+
+// Weak variables to released values never upgrade, not even after new values recreated their blocks under the same ids
+void test_weak_var_expiry() {
+    std::vector<dima::Var<Node>> nodes;
+    for (size_t i = 0; i < 5000; i++) {
+        nodes.emplace_back(Node::allocate(i));
+    }
+    const std::vector<dima::WeakVar<Node>> weak_vars(nodes.begin(), nodes.end());
+    for (size_t i = 0; i < weak_vars.size(); i++) {
+        const std::optional<dima::Var<Node>> upgraded = weak_vars[i].upgrade();
+        check(upgraded.has_value() && upgraded.value()->value == i, "weak var: a weak variable to a live value did not upgrade");
+    }
+    nodes.clear();
+    for (const auto &weak : weak_vars) {
+        check(!weak.upgrade().has_value(), "weak var: a weak variable to a released value upgraded");
+    }
+    // All blocks were destroyed with their last value, so the new values recreate them
+    for (size_t i = 0; i < weak_vars.size(); i++) {
+        nodes.emplace_back(Node::allocate(i));
+    }
+    for (const auto &weak : weak_vars) {
+        check(!weak.upgrade().has_value(), "weak var: a weak variable upgraded to a value of a recreated block");
+    }
+    nodes.clear();
+}
+
+// A compactable type, whose values are moved out of sparse blocks by `compact`
+struct CompactionPolicy : dima::default_policy {
+    using compaction = dima::incremental_compaction<>;
+};
+
+class CompactNode : public dima::Type<CompactNode, CompactionPolicy> {
+  public:
+    std::string name;
+
+    CompactNode(const size_t value) :
+        name("node_" + std::to_string(value)) {}
+};
+
+// Compacting sparse blocks gives blocks back and moves every surviving value along with all variables referring to it
+void test_compaction() {
+    std::vector<dima::Var<CompactNode>> nodes;
+    for (size_t i = 0; i < 20000; i++) {
+        nodes.emplace_back(CompactNode::allocate(i));
+    }
+    const size_t capacity = CompactNode::get_capacity();
+    // Only every fourth value survives, which leaves every block sparse enough to be compacted
+    std::vector<dima::Var<CompactNode>> survivors;
+    for (size_t i = 0; i < nodes.size(); i += 4) {
+        survivors.emplace_back(std::move(nodes[i]));
+    }
+    nodes.clear();
+    while (CompactNode::compact(std::chrono::microseconds(100)) > 0) {}
+    check(CompactNode::get_capacity() < capacity, "compaction: compact() did not give the sparse blocks back");
+    for (size_t i = 0; i < survivors.size(); i++) {
+        check(survivors[i]->name == "node_" + std::to_string(i * 4), "compaction: compact() lost a value");
+    }
+    survivors.clear();
+    check(CompactNode::get_allocation_count() == 0, "compaction: not all values were freed");
+}
+
+// A compactable type with small blocks, so a single array fills a block of its own
+struct ArrayCompactionPolicy : dima::default_policy {
+    using sizing = dima::fixed_capacity<64>;
+    using compaction = dima::incremental_compaction<50>;
+};
+
+class CompactElement : public dima::Type<CompactElement, ArrayCompactionPolicy> {
+  public:
+    size_t value;
+
+    CompactElement(const size_t value) :
+        value(value) {}
+};
+
+// The elements of a live array are never moved by compaction, as the array refers to them through raw slot pointers
+void test_array_compaction() {
+    std::vector<dima::Var<CompactElement>> elements;
+    for (size_t i = 0; i < 60; i++) {
+        elements.emplace_back(CompactElement::allocate(i));
+    }
+    // The array does not fit next to the values anymore, so it is the only thing in a sparse block of its own
+    dima::Array<CompactElement> array = CompactElement::allocate_array(4, 7);
+    elements.erase(elements.begin(), elements.begin() + 20);
+    CompactElement::compact(std::chrono::milliseconds(100));
+    for (size_t i = 0; i < array.size(); i++) {
+        check(array[i]->value == 7, "array compaction: compact() moved an element of a live array");
+    }
+    for (size_t i = 0; i < elements.size(); i++) {
+        check(elements[i]->value == i + 20, "array compaction: compact() lost a value");
+    }
+}
+
+// A type whose emptied blocks are kept alive for reuse
+struct RetainedPolicy : dima::default_policy {
+    using retention = dima::keep_empty_blocks<4>;
+};
+
+class RetainedNode : public dima::Type<RetainedNode, RetainedPolicy> {
+  public:
+    size_t value;
+
+    RetainedNode(const size_t value) :
+        value(value) {}
+};
+
+// Trimming gives back all empty blocks the retention policy kept alive
+void test_trim() {
+    std::vector<dima::Var<RetainedNode>> nodes;
+    for (size_t i = 0; i < 20000; i++) {
+        nodes.emplace_back(RetainedNode::allocate(i));
+    }
+    nodes.clear();
+    check(RetainedNode::get_capacity() > 0, "trim: no emptied block was retained");
+    const size_t trimmed = RetainedNode::trim();
+    check(trimmed > 0 && trimmed <= 4 && RetainedNode::get_capacity() == 0, "trim: trim() left empty blocks alive");
+}
+
+// A type whose released values are destroyed through `dima::reclaim`
+class DeferredNode : public dima::Type<DeferredNode, dima::deferred> {
+  public:
+    size_t value;
+
+    DeferredNode(const size_t value) :
+        value(value) {}
+};
+
+// Released values of a deferred type are only freed once they are reclaimed, and reclaiming in small steps frees all of them
+void test_deferred_reclamation() {
+    std::vector<dima::Var<DeferredNode>> nodes;
+    for (size_t i = 0; i < 10000; i++) {
+        nodes.emplace_back(DeferredNode::allocate(i));
+    }
+    nodes.clear();
+    check(DeferredNode::get_allocation_count() == 10000, "deferred: a released value was freed before it was reclaimed");
+    size_t reclaimed = 0;
+    while (true) {
+        const size_t step = dima::reclaim(std::chrono::microseconds(100), 1000);
+        if (step == 0) {
+            break;
+        }
+        check(step <= 1000, "deferred: reclaim() went over its value budget");
+        reclaimed += step;
+    }
+    check(reclaimed == 10000 && DeferredNode::get_allocation_count() == 0, "deferred: not all released values were reclaimed");
+}
+
+struct SingleSlotDeferredPolicy : dima::deferred {
+    using sizing = dima::fixed_capacity<1>;
+};
+
+// A deferred type whose every value lives in its own block, so reclaiming any of its values gives a whole block back
+class DeferredLeaf : public dima::Type<DeferredLeaf, SingleSlotDeferredPolicy> {
+  public:
+    size_t value;
+
+    DeferredLeaf(const size_t value) :
+        value(value) {}
+};
+
+// Giving a block back is the most expensive part of reclaiming a value, so a step whose deadline has passed stops right after it
+void test_reclaim_block_budget() {
+    std::vector<dima::Var<DeferredLeaf>> leaves;
+    for (size_t i = 0; i < 64; i++) {
+        leaves.emplace_back(DeferredLeaf::allocate(i));
+    }
+    leaves.clear();
+    check(dima::reclaim(std::chrono::microseconds(0)) == 1, "deferred: reclaim() kept going after a block teardown past its deadline");
+    while (dima::reclaim(std::chrono::microseconds(0)) > 0) {}
+    check(DeferredLeaf::get_capacity() == 0, "deferred: not all emptied blocks were given back");
+}
+
+// The words of a bitmap are only initialized once they are needed, so every search has to see the untouched words as free. Random changes
+// are mirrored in a plain vector, and every search of the bitmap is compared against it
+void test_lazy_bitmap() {
+    uint64_t state = 42;
+    const auto next = [&state](const uint32_t bound) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<uint32_t>((state >> 33) % bound);
+    };
+    for (const uint32_t bit_count : {1u, 63u, 64u, 65u, 200u, 4096u, 5000u}) {
+        dima::Bitmap bitmap(bit_count);
+        std::vector<bool> bits(bit_count, false);
+        for (size_t step = 0; step < 2000; step++) {
+            // Changes only reach further into the bitmap over time, just like the bump index of a block
+            const uint32_t reach = std::min<uint32_t>(bit_count, 1 + static_cast<uint32_t>(step * bit_count / 1000));
+            const uint32_t idx = next(reach);
+            switch (next(3)) {
+                case 0:
+                    bitmap.set(idx);
+                    bits[idx] = true;
+                    break;
+                case 1:
+                    bitmap.clear(idx);
+                    bits[idx] = false;
+                    break;
+                default: {
+                    const uint32_t length = std::min(bit_count - idx, next(100));
+                    bitmap.set_range(idx, length);
+                    std::fill(bits.begin() + idx, bits.begin() + idx + length, true);
+                    break;
+                }
+            }
+            const uint32_t from = next(bit_count);
+            std::optional<uint32_t> expected_set;
+            for (uint32_t i = from; i < bit_count && !expected_set.has_value(); i++) {
+                if (bits[i]) {
+                    expected_set = i;
+                }
+            }
+            check(bitmap.find_next_set(from) == expected_set, "lazy bitmap: find_next_set missed a set bit");
+            uint32_t largest = 0;
+            for (uint32_t i = 0, run = 0; i < bit_count; i++) {
+                run = bits[i] ? 0 : run + 1;
+                largest = std::max(largest, run);
+            }
+            check(bitmap.get_largest_free_run() == largest, "lazy bitmap: get_largest_free_run is wrong");
+            const uint32_t length = 1 + next(bit_count);
+            const std::optional<uint32_t> run = bitmap.find_free_run(length);
+            check(run.has_value() == (length <= largest), "lazy bitmap: find_free_run missed a free run");
+            if (run.has_value()) {
+                for (uint32_t i = run.value(); i < run.value() + length; i++) {
+                    check(i < bit_count && !bits[i], "lazy bitmap: find_free_run found an occupied bit");
+                }
+            }
+        }
+        uint32_t visited = 0;
+        bitmap.for_each_set([&](const uint32_t idx) {
+            check(idx < bit_count && bits[idx], "lazy bitmap: for_each_set visited a free bit");
+            visited++;
+        });
+        check(visited == static_cast<uint32_t>(std::count(bits.begin(), bits.end(), true)), "lazy bitmap: for_each_set missed a set bit");
+    }
+}
+
+// A type whose values are allocated and released from many threads at once in shared blocks
+class ConcurrentNode : public dima::Type<ConcurrentNode, dima::concurrent> {
+  public:
+    size_t value;
+
+    ConcurrentNode(const size_t value) :
+        value(value) {}
+};
+
+// Counts how often a block let its owner know that it became empty
+class EmptiedCounter : public dima::BlockOwner<ConcurrentNode> {
+  public:
+    std::atomic<size_t> emptied{0};
+
+    void block_emptied(dima::Block<ConcurrentNode> *) override {
+        emptied++;
+    }
+
+    void block_gained_space(dima::Block<ConcurrentNode> *) override {}
+};
+
+// Threads racing for the slots of one concurrent block never get the same slot, and of all the threads which free the last slots at the
+// same time exactly one lets the owner know that the block became empty
+void test_concurrent_block() {
+    constexpr size_t THREADS = 4;
+    constexpr uint32_t CAPACITY = 1000;
+    EmptiedCounter counter;
+    dima::Block<ConcurrentNode> block(0, CAPACITY);
+    block.set_owner(&counter, false);
+    for (size_t round = 1; round <= 50; round++) {
+        std::vector<std::vector<dima::Slot<ConcurrentNode> *>> claimed(THREADS);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < THREADS; t++) {
+            threads.emplace_back([&block, &claimed, t]() {
+                while (dima::Slot<ConcurrentNode> *slot = block.reserve_slot()) {
+                    claimed[t].push_back(slot);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        std::vector<dima::Slot<ConcurrentNode> *> all;
+        for (const auto &slots : claimed) {
+            all.insert(all.end(), slots.begin(), slots.end());
+        }
+        std::sort(all.begin(), all.end());
+        check(all.size() == CAPACITY && std::adjacent_find(all.begin(), all.end()) == all.end(),
+            "concurrent block: a slot was claimed twice or not at all");
+        threads.clear();
+        for (size_t t = 0; t < THREADS; t++) {
+            threads.emplace_back([&block, &claimed, t]() {
+                for (dima::Slot<ConcurrentNode> *slot : claimed[t]) {
+                    block.free_slot(slot);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        check(counter.emptied == round, "concurrent block: the owner did not hear of the emptying exactly once");
+    }
+}
+
+// Values of a concurrent type allocated on many threads at once keep their own slots, and trimming gives back all blocks once they are
+// empty again
+void test_concurrent_head() {
+    constexpr size_t THREADS = 4;
+    constexpr size_t COUNT = 20000;
+    std::atomic<bool> wrong{false};
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < THREADS; t++) {
+        threads.emplace_back([&wrong, t]() {
+            std::vector<dima::Var<ConcurrentNode>> nodes;
+            for (size_t i = 0; i < COUNT; i++) {
+                nodes.emplace_back(ConcurrentNode::allocate(t * COUNT + i));
+                if (i % 1000 == 999) {
+                    for (size_t j = 0; j < nodes.size(); j++) {
+                        if (nodes[j]->value != t * COUNT + i - 999 + j) {
+                            wrong = true;
+                        }
+                    }
+                    nodes.clear();
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    check(!wrong, "concurrent head: a slot was handed out to two threads");
+    check(ConcurrentNode::get_allocation_count() == 0, "concurrent head: the occupied count does not match the live values");
+    check(ConcurrentNode::trim() > 0 && ConcurrentNode::get_capacity() == 0, "concurrent head: trim() left empty blocks alive");
+}
+
+int main() {
+    std::cout << "-- Running the unit tests..." << std::endl;
+    test_throwing_constructor<Thrower>("uncached");
+    test_throwing_constructor<CachedThrower>("cached");
+    test_throwing_array();
+    test_throwing_bulk<Thrower>("uncached bulk");
+    test_throwing_bulk<CachedThrower>("cached bulk");
+    test_releasing_constructor();
+    test_cache_outlives_head();
+    test_biased_handover();
+    test_stale_weak_handles();
+    test_handle_reach<SmallNode>(16 * 1000, "many blocks");
+    test_handle_reach<Node>(3000000, "large blocks");
+    test_concurrent_upgrades();
+    test_weak_var_expiry();
+    test_compaction();
+    test_array_compaction();
+    test_trim();
+    test_deferred_reclamation();
+    test_reclaim_block_budget();
+    test_lazy_bitmap();
+    test_concurrent_block();
+    test_concurrent_head();
+    std::cout << "-- All unit tests passed" << std::endl;
+    return 0;
+}